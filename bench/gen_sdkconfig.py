@@ -0,0 +1,38 @@
+#!/usr/bin/env python3
+#
+# Create a sdkconfig.h from the project's sdkconfig for the host benchmarks.
+# Usage: gen_sdkconfig.py sdkconfig sdkconfig.h [NAME=VALUE ...]
+#
+# NAME is given without the CONFIG_ prefix. Values y and n become defined and
+# undefined symbols, like in the header generated by ESP-IDF.
+
+import re
+import sys
+
+def main(sdkconfig, header, overrides):
+    values = {}
+
+    for line in open(sdkconfig):
+        line = line.strip()
+
+        if match := re.match(r"(CONFIG_\w+)=(.*)", line):
+            values[match.group(1)] = match.group(2)
+        elif match := re.match(r"# (CONFIG_\w+) is not set", line):
+            values[match.group(1)] = "n"
+
+    for override in overrides:
+        name, value = override.split("=", 1)
+        values["CONFIG_" + name] = value
+
+    with open(header, "w") as file:
+        file.write("/* Generated by gen_sdkconfig.py - do not edit */\n")
+        file.write("#pragma once\n")
+
+        for name, value in values.items():
+            if value == "y":
+                file.write(f"#define {name} 1\n")
+            elif value != "n":
+                file.write(f"#define {name} {value}\n")
+
+if __name__ == "__main__":
+    main(sys.argv[1], sys.argv[2], sys.argv[3:])
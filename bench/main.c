@@ -0,0 +1,85 @@
+/*
+ * Klimper: ESP32 I²S Synthesizer Test
+ * © 2024 Dennis Schulmeister-Zimolong <dennis@wpvs.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ */
+
+#include <stdio.h>                          // FILE, fopen(), fwrite()
+#include <stdlib.h>                         // strtoul(), strtof()
+#include <string.h>                         // strcmp()
+#include <time.h>                           // clock_gettime()
+
+#include "bench.h"                          // bench_run(), bench_render()
+#include "sdkconfig.h"                      // CONFIG_AUDIO_SAMPLE_RATE
+
+/**
+ * Monotonic host clock in nanoseconds.
+ */
+static uint64_t bench_clock_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Write the header of a 16-bit stereo WAV file with the given number of data bytes.
+ * The host is assumed to be little endian, like the target.
+ */
+static void bench_wav_header(FILE* file, uint32_t n_bytes) {
+    uint32_t rate = CONFIG_AUDIO_SAMPLE_RATE;
+    uint32_t header[] = {
+        0x46464952, 36 + n_bytes,           // "RIFF", chunk size
+        0x45564157,                         // "WAVE"
+        0x20746d66, 16,                     // "fmt ", chunk size
+        0x00020001,                         // PCM, 2 channels
+        rate, rate * 4,                     // Sample rate, bytes per second
+        0x00100004,                         // 4 bytes per frame, 16 bits per sample
+        0x61746164, n_bytes,                // "data", chunk size
+    };
+
+    fseek(file, 0, SEEK_SET);
+    fwrite(header, sizeof(header), 1, file);
+}
+
+/**
+ * Output function of the offline render, appending the samples to the WAV file.
+ */
+static void bench_wav_write(const int16_t* samples, size_t n, void* arg) {
+    fwrite(samples, sizeof(int16_t), n, (FILE*) arg);
+}
+
+/**
+ * Host entry point. The optional argument is the number of samples per scenario.
+ * Alternatively `--render out.wav [seconds]` only runs the offline render and
+ * writes its output into a WAV file.
+ */
+int main(int argc, char** argv) {
+    if (argc > 2 && !strcmp(argv[1], "--render")) {
+        float seconds = argc > 3 ? strtof(argv[3], NULL) : 60.0f;
+
+        FILE* file = fopen(argv[2], "wb");
+        if (!file) {
+            perror(argv[2]);
+            return 1;
+        }
+
+        bench_wav_header(file, 0);
+        bench_render(bench_clock_ns, 1000000000ULL, seconds, bench_wav_write, file);
+
+        long size = ftell(file);
+        bench_wav_header(file, (uint32_t) size - 44);
+        fclose(file);
+        return 0;
+    }
+
+    size_t n_samples = 1 << 22;
+    if (argc > 1) n_samples = strtoul(argv[1], NULL, 0);
+
+    bench_run(bench_clock_ns, "ns", n_samples);
+    bench_render(bench_clock_ns, 1000000000ULL, 60.0f, NULL, NULL);
+    return 0;
+}
@@ -0,0 +1,22 @@
+/*
+ * Klimper: ESP32 I²S Synthesizer Test
+ * © 2024 Dennis Schulmeister-Zimolong <dennis@wpvs.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ */
+
+/**
+ * Host replacement for the ESP-IDF memory placement attributes. The host has no
+ * separate instruction RAM, so all placement attributes are empty. The inlining
+ * attribute is defined like in ESP-IDF.
+ */
+
+#pragma once
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define EXT_RAM_BSS_ATTR
+#define FORCE_INLINE_ATTR static inline __attribute__((always_inline))
@@ -0,0 +1,44 @@
+/*
+ * Klimper: ESP32 I²S Synthesizer Test
+ * © 2024 Dennis Schulmeister-Zimolong <dennis@wpvs.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ */
+
+/**
+ * Host replacement for the ESP-IDF capability-based heap allocator. The host has
+ * only one kind of memory, so the capabilities are ignored, except that requests
+ * for PSRAM fail like on a board without one.
+ */
+
+#pragma once
+
+#include <stdlib.h>                         // aligned_alloc(), calloc(), free()
+#include <string.h>                         // memset()
+
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_8BIT     (1 << 2)
+#define MALLOC_CAP_SPIRAM   (1 << 10)
+
+static inline void* heap_caps_aligned_calloc(size_t alignment, size_t n, size_t size, unsigned caps) {
+    size_t length = (n * size + alignment - 1) / alignment * alignment;
+    void*  memory = aligned_alloc(alignment, length);
+    if (memory) memset(memory, 0, length);
+    return memory;
+}
+
+static inline void* heap_caps_calloc(size_t n, size_t size, unsigned caps) {
+    if (caps & MALLOC_CAP_SPIRAM) return NULL;
+    return calloc(n, size);
+}
+
+static inline void* heap_caps_malloc(size_t size, unsigned caps) {
+    return malloc(size);
+}
+
+static inline void heap_caps_free(void* memory) {
+    free(memory);
+}
@@ -0,0 +1,24 @@
+/*
+ * Klimper: ESP32 I²S Synthesizer Test
+ * © 2024 Dennis Schulmeister-Zimolong <dennis@wpvs.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ */
+
+/**
+ * Host replacement for the ESP-IDF logging macros. Errors and warnings go to stderr
+ * so that they don't mix with the benchmark results, everything else is dropped.
+ */
+
+#pragma once
+
+#include <stdio.h>                          // fprintf()
+
+#define ESP_LOGE(tag, format, ...) fprintf(stderr, "E %s: " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) fprintf(stderr, "W %s: " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) do { (void) (tag); } while (0)
+#define ESP_LOGD(tag, format, ...) do { (void) (tag); } while (0)
+#define ESP_LOGV(tag, format, ...) do { (void) (tag); } while (0)
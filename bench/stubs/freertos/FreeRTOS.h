@@ -0,0 +1,22 @@
+/*
+ * Klimper: ESP32 I²S Synthesizer Test
+ * © 2024 Dennis Schulmeister-Zimolong <dennis@wpvs.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ */
+
+/**
+ * Host replacement for the FreeRTOS base header. Only the tick type is needed, since
+ * the processing cycle includes the audio hardware header for its sample format.
+ */
+
+#pragma once
+
+#include <stdint.h>                         // uint32_t
+
+typedef uint32_t TickType_t;
+
+#define portMAX_DELAY ((TickType_t) 0xffffffffUL)
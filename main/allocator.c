@@ -0,0 +1,164 @@
+/*
+ * Klimper: ESP32 I²S Synthesizer Test
+ * © 2024 Dennis Schulmeister-Zimolong <dennis@wpvs.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ */
+
+#include "allocator.h"
+
+#include <esp_log.h>                        // ESP_LOGx
+#include <esp_attr.h>                       // IRAM_ATTR
+#include <stdlib.h>                         // calloc(), free()
+#include "trace.h"                          // trace_record()
+
+static const char* TAG = "allocator";
+
+/**
+ * List a voice is on.
+ */
+typedef enum {
+    ALLOCATOR_FREE,                         // On the free stack
+    ALLOCATOR_HELD,                         // In the held list
+    ALLOCATOR_RELEASED,                     // In the released list
+} allocator_state_t;
+
+/**
+ * Create new voice allocator instance.
+ */
+allocator_t* allocator_new(int n_voices) {
+    ESP_LOGD(TAG, "Creating new voice allocator instance");
+
+    allocator_t* allocator = calloc(1, sizeof(allocator_t));
+
+    allocator->n_voices   = n_voices;
+    allocator->free       = calloc(n_voices, sizeof(int16_t));
+    allocator->prev       = calloc(n_voices, sizeof(int16_t));
+    allocator->next       = calloc(n_voices, sizeof(int16_t));
+    allocator->state      = calloc(n_voices, sizeof(uint8_t));
+    allocator->voice_note = calloc(n_voices, sizeof(int16_t));
+
+    allocator->held.head     = allocator->held.tail     = ALLOCATOR_NONE;
+    allocator->released.head = allocator->released.tail = ALLOCATOR_NONE;
+
+    // Lowest voice on top of the stack, so that the voices are used in order
+    for (int i = 0; i < n_voices; i++) {
+        allocator->free[i]       = n_voices - 1 - i;
+        allocator->voice_note[i] = ALLOCATOR_NONE;
+    }
+
+    allocator->n_free = n_voices;
+
+    for (int i = 0; i < ALLOCATOR_N_NOTES; i++) {
+        allocator->note_voice[i] = ALLOCATOR_NONE;
+    }
+
+    ESP_LOGI(TAG, "Created voice allocator instance %p with %i voices", allocator, n_voices);
+
+    return allocator;
+}
+
+/**
+ * Free voice allocator instance.
+ */
+void allocator_free(allocator_t* allocator) {
+    ESP_LOGD(TAG, "Freeing voice allocator instance %p", allocator);
+
+    free(allocator->free);
+    free(allocator->prev);
+    free(allocator->next);
+    free(allocator->state);
+    free(allocator->voice_note);
+    free(allocator);
+}
+
+/**
+ * Append a voice to the end of a list.
+ */
+static inline void allocator_list_append(allocator_t* allocator, allocator_list_t* list, int voice) {
+    allocator->prev[voice] = list->tail;
+    allocator->next[voice] = ALLOCATOR_NONE;
+
+    if (list->tail != ALLOCATOR_NONE) allocator->next[list->tail] = voice;
+    else list->head = voice;
+
+    list->tail = voice;
+}
+
+/**
+ * Unlink a voice from the list it is in.
+ */
+static inline void allocator_list_remove(allocator_t* allocator, int voice) {
+    allocator_list_t* list = allocator->state[voice] == ALLOCATOR_HELD ? &allocator->held : &allocator->released;
+
+    int16_t prev = allocator->prev[voice];
+    int16_t next = allocator->next[voice];
+
+    if (prev != ALLOCATOR_NONE) allocator->next[prev] = next;
+    else list->head = next;
+
+    if (next != ALLOCATOR_NONE) allocator->prev[next] = prev;
+    else list->tail = prev;
+}
+
+/**
+ * Allocate a voice for a new note. Re-trigger, free voice, oldest released voice,
+ * oldest held voice, in that order.
+ */
+int IRAM_ATTR allocator_note_on(allocator_t* allocator, int note) {
+    int voice = allocator->note_voice[note];
+
+    if (voice != ALLOCATOR_NONE) {
+        allocator_list_remove(allocator, voice);
+    } else {
+        if (allocator->n_free > 0) {
+            voice = allocator->free[--allocator->n_free];
+        } else {
+            voice = allocator->released.head != ALLOCATOR_NONE ? allocator->released.head : allocator->held.head;
+            trace_record(TRACE_VOICE_STEAL, (uint16_t) voice);
+
+            allocator_list_remove(allocator, voice);
+            allocator->note_voice[allocator->voice_note[voice]] = ALLOCATOR_NONE;
+        }
+
+        allocator->note_voice[note]  = voice;
+        allocator->voice_note[voice] = note;
+    }
+
+    allocator_list_append(allocator, &allocator->held, voice);
+    allocator->state[voice] = ALLOCATOR_HELD;
+
+    return voice;
+}
+
+/**
+ * Move the voice of a held note to the end of the released list.
+ */
+int IRAM_ATTR allocator_note_off(allocator_t* allocator, int note) {
+    int voice = allocator->note_voice[note];
+    if (voice == ALLOCATOR_NONE || allocator->state[voice] != ALLOCATOR_HELD) return ALLOCATOR_NONE;
+
+    allocator_list_remove(allocator, voice);
+    allocator_list_append(allocator, &allocator->released, voice);
+    allocator->state[voice] = ALLOCATOR_RELEASED;
+
+    return voice;
+}
+
+/**
+ * Put a stopped voice back on the free stack.
+ */
+void IRAM_ATTR allocator_voice_stopped(allocator_t* allocator, int voice) {
+    if (allocator->state[voice] == ALLOCATOR_FREE) return;
+
+    allocator_list_remove(allocator, voice);
+    allocator->state[voice] = ALLOCATOR_FREE;
+
+    allocator->note_voice[allocator->voice_note[voice]] = ALLOCATOR_NONE;
+    allocator->voice_note[voice] = ALLOCATOR_NONE;
+
+    allocator->free[allocator->n_free++] = voice;
+}
@@ -0,0 +1,95 @@
+/*
+ * Klimper: ESP32 I²S Synthesizer Test
+ * © 2024 Dennis Schulmeister-Zimolong <dennis@wpvs.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ */
+
+#pragma once
+
+#include <stdint.h>                         // int16_t, uint8_t
+
+#define ALLOCATOR_N_NOTES (128)             // Number of MIDI notes
+#define ALLOCATOR_NONE    (-1)              // No voice / no note
+
+/**
+ * Doubly-linked list of voices, ordered from the oldest to the newest entry.
+ */
+typedef struct {
+    int16_t head;                           // Oldest voice (`ALLOCATOR_NONE` if empty)
+    int16_t tail;                           // Newest voice (`ALLOCATOR_NONE` if empty)
+} allocator_list_t;
+
+/**
+ * Voice allocator with constant-time note-on, note-off and voice release. The allocator
+ * only keeps the book, the voices themselves are owned by the synthesizer. Free voices
+ * are kept on a stack. Sounding voices are kept in two lists ordered by the time of their
+ * last note event, which are the steal candidates in order of priority: First the voice
+ * released longest ago, which has decayed the most, then the voice held longest. A table
+ * from note number to voice finds re-triggered notes without searching.
+ *
+ * The allocator is not thread-safe. It must only be used by the task calling the
+ * synthesizer.
+ */
+typedef struct {
+    int n_voices;                           // Number of voices
+
+    int16_t* free;                          // Stack of free voices
+    int      n_free;                        // Number of free voices
+
+    allocator_list_t held;                  // Sounding voices whose note is held
+    allocator_list_t released;              // Sounding voices whose note has been released
+
+    int16_t* prev;                          // Previous voice in the list of each voice
+    int16_t* next;                          // Next voice in the list of each voice
+    uint8_t* state;                         // List of each voice (`allocator_state_t`)
+    int16_t* voice_note;                    // Note of each voice (`ALLOCATOR_NONE` if free)
+
+    int16_t  note_voice[ALLOCATOR_N_NOTES]; // Voice of each note (`ALLOCATOR_NONE` if not sounding)
+} allocator_t;
+
+/**
+ * Create a new voice allocator with all voices free.
+ *
+ * @param n_voices Number of voices
+ * @returns Pointer to the voice allocator
+ */
+allocator_t* allocator_new(int n_voices);
+
+/**
+ * Delete a voice allocator as a replacement for `free()`.
+ *
+ * @param allocator Voice allocator
+ */
+void allocator_free(allocator_t* allocator);
+
+/**
+ * Allocate a voice for a new note. A voice already sounding the same note is re-triggered.
+ * Otherwise a free voice is used, or if there is none, the best steal candidate. In any
+ * case the voice becomes the newest held voice.
+ *
+ * @param allocator Voice allocator
+ * @param note MIDI note number [0 … 127]
+ * @returns Index of the voice to play the note
+ */
+int allocator_note_on(allocator_t* allocator, int note);
+
+/**
+ * Mark the voice of a held note as released.
+ *
+ * @param allocator Voice allocator
+ * @param note MIDI note number [0 … 127]
+ * @returns Index of the released voice or `ALLOCATOR_NONE` if the note is not held
+ */
+int allocator_note_off(allocator_t* allocator, int note);
+
+/**
+ * Return a voice to the free voices, once it has stopped sounding.
+ *
+ * @param allocator Voice allocator
+ * @param voice Index of the voice
+ */
+void allocator_voice_stopped(allocator_t* allocator, int voice);
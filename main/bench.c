@@ -0,0 +1,504 @@
+/*
+ * Klimper: ESP32 I²S Synthesizer Test
+ * © 2024 Dennis Schulmeister-Zimolong <dennis@wpvs.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ */
+
+#include "bench.h"
+
+#include <inttypes.h>                       // PRIx32
+#include <stdio.h>                          // printf()
+#include <stdlib.h>                         // srand()
+#include <string.h>                         // memset()
+#include "dsp/adsr.h"                       // dsp_adsr_xyz
+#include "dsp/delay.h"                      // dsp_delay_xyz
+#include "dsp/mix.h"                        // dsp_mix_clear()
+#include "dsp/oscil.h"                      // dsp_oscil_xyz
+#include "dsp/pan.h"                        // dsp_pan_xyz
+#include "dsp/sample.h"                     // dsp_sample_t
+#include "dsp/wavetable.h"                  // dsp_wavetable_xyz
+#include "event.h"                          // event_xyz
+#include "render.h"                         // render_xyz
+#include "sequencer.h"                      // sequencer_xyz
+#include "synth.h"                          // synth_xyz
+
+#if CONFIG_BENCH_ON_TARGET
+    #include <freertos/FreeRTOS.h>          // Common FreeRTOS (must come first)
+    #include <freertos/task.h>              // vTaskDelay()
+    #include <esp_cpu.h>                    // esp_cpu_get_cycle_count()
+#endif
+
+#define BENCH_BLOCK (64)                    // Block size for the block functions
+#define BENCH_SEED  (1)                     // Fixed random seed, so that each run renders the same
+
+static const int bench_voices[] = {1, 4, 8, 16, 32};
+
+static volatile uint32_t bench_sink;        // Keeps the compiler from optimizing the results away
+
+/**
+ * Print one result line.
+ */
+static void bench_report(const char* name, uint64_t time, size_t n, const char* unit, const char* per) {
+    printf("%-36s %10.2f %s/%s\n", name, (double) time / n, unit, per);
+}
+
+/**
+ * Give the idle task a chance to run between two scenarios, so that the task
+ * watchdog doesn't complain on the target.
+ */
+static void bench_yield() {
+#if CONFIG_BENCH_ON_TARGET
+    vTaskDelay(1);
+#endif
+}
+
+/**
+ * Oscillator tick and block function of the configured DSP engine.
+ */
+static void bench_oscil(bench_clock_ptr clock, const char* unit, size_t n_samples) {
+#if CONFIG_DSP_ENGINE_LOG
+    dsp_wavetable_t* wavetable = dsp_wavetable_get(DSP_WAVETABLE_LOGSIN);
+#else
+    dsp_wavetable_t* wavetable = dsp_wavetable_get(DSP_WAVETABLE_COS);
+#endif
+
+    dsp_oscil_t* oscil = dsp_oscil_new(wavetable);
+    dsp_oscil_reinit(oscil, 440.0f, true);
+
+    uint32_t sum   = 0;
+    uint64_t start = clock();
+
+    for (size_t i = 0; i < n_samples; i++) {
+#if CONFIG_DSP_ENGINE_FIXED
+        sum += dsp_oscil_tick_q15(oscil, 0);
+#elif CONFIG_DSP_ENGINE_LOG
+        sum += dsp_oscil_tick_log(oscil, 0);
+#else
+        sum += (int32_t) (dsp_oscil_tick(oscil, 0.0f) * 32767.0f);
+#endif
+    }
+
+    bench_report("dsp_oscil_tick", clock() - start, n_samples, unit, "sample");
+    bench_yield();
+
+#if CONFIG_DSP_ENGINE_FIXED
+    q15_t block[BENCH_BLOCK];
+#elif CONFIG_DSP_ENGINE_LOG
+    dsp_log_t block[BENCH_BLOCK];
+#else
+    float block[BENCH_BLOCK];
+#endif
+
+    start = clock();
+
+    for (size_t i = 0; i < n_samples; i += BENCH_BLOCK) {
+#if CONFIG_DSP_ENGINE_FIXED
+        dsp_oscil_process_q15(oscil, NULL, block, BENCH_BLOCK);
+#elif CONFIG_DSP_ENGINE_LOG
+        dsp_oscil_process_log(oscil, NULL, block, BENCH_BLOCK);
+#else
+        dsp_oscil_process(oscil, NULL, block, BENCH_BLOCK);
+#endif
+        sum += (uint32_t) block[i % BENCH_BLOCK];
+    }
+
+    bench_report("dsp_oscil_process", clock() - start, n_samples, unit, "sample");
+    bench_yield();
+
+    dsp_oscil_free(oscil);
+    bench_sink = sum;
+}
+
+/**
+ * Envelope tick and block function of the configured DSP engine. The envelope is
+ * re-triggered periodically, so that all segments are part of the measurement.
+ */
+static void bench_adsr(bench_clock_ptr clock, const char* unit, size_t n_samples) {
+    dsp_adsr_values_t values = {
+        .attack  = 0.01f,
+        .peak    = 1.0f,
+        .decay   = 0.05f,
+        .sustain = 0.5f,
+        .release = 0.05f,
+    };
+
+    dsp_adsr_t* adsr = dsp_adsr_new();
+    dsp_adsr_set_values(adsr, &values);
+
+    static const size_t period = 8192;
+    uint32_t sum   = 0;
+    uint64_t start = clock();
+
+    for (size_t i = 0; i < n_samples; i += period) {
+        dsp_adsr_trigger_attack(adsr);
+
+        for (size_t j = 0; j < period; j++) {
+            if (j == period / 2) dsp_adsr_trigger_release(adsr);
+
+#if CONFIG_DSP_ENGINE_FIXED
+            sum += dsp_adsr_tick_q15(adsr);
+#elif CONFIG_DSP_ENGINE_LOG
+            sum += dsp_adsr_tick_log(adsr);
+#else
+            sum += (int32_t) (dsp_adsr_tick(adsr) * 32767.0f);
+#endif
+        }
+    }
+
+    bench_report("dsp_adsr_tick", clock() - start, n_samples, unit, "sample");
+    bench_yield();
+
+#if CONFIG_DSP_ENGINE_FIXED
+    q15_t block[BENCH_BLOCK];
+#elif CONFIG_DSP_ENGINE_LOG
+    dsp_log_t block[BENCH_BLOCK];
+#else
+    float block[BENCH_BLOCK];
+#endif
+
+    start = clock();
+
+    for (size_t i = 0; i < n_samples; i += period) {
+        dsp_adsr_trigger_attack(adsr);
+
+        for (size_t j = 0; j < period; j += BENCH_BLOCK) {
+            if (j == period / 2) dsp_adsr_trigger_release(adsr);
+
+#if CONFIG_DSP_ENGINE_FIXED
+            dsp_adsr_process_q15(adsr, block, BENCH_BLOCK);
+#elif CONFIG_DSP_ENGINE_LOG
+            dsp_adsr_process_log(adsr, block, BENCH_BLOCK);
+#else
+            dsp_adsr_process(adsr, block, BENCH_BLOCK);
+#endif
+            sum += (uint32_t) block[j % BENCH_BLOCK];
+        }
+    }
+
+    bench_report("dsp_adsr_process", clock() - start, n_samples, unit, "sample");
+    bench_yield();
+
+    dsp_adsr_free(adsr);
+    bench_sink = sum;
+}
+
+/**
+ * Pan law of the configured DSP engine with a sweeping pan value.
+ */
+static void bench_pan(bench_clock_ptr clock, const char* unit, size_t n_samples) {
+    dsp_pan_init();
+
+    uint32_t sum   = 0;
+    uint64_t start = clock();
+
+    for (size_t i = 0; i < n_samples; i++) {
+        q15_t pan = (q15_t) ((i & 0xffff) - 0x8000);
+
+#if CONFIG_DSP_ENGINE_FIXED
+        q15_t left, right;
+        dsp_pan_stereo_q15(16384, pan, &left, &right);
+#elif CONFIG_DSP_ENGINE_LOG
+        dsp_log_t left, right;
+        dsp_pan_stereo_log(DSP_LOG_OCTAVE, pan, &left, &right);
+#else
+        float left, right;
+        dsp_pan_stereo(0.5f, pan * (1.0f / 32768.0f), &left, &right);
+#endif
+
+        sum += (int32_t) left + (int32_t) right;
+    }
+
+    bench_report("dsp_pan_stereo", clock() - start, n_samples, unit, "sample");
+    bench_yield();
+
+    bench_sink = sum;
+}
+
+/**
+ * Stereo delay with the chorus settings of `main.c` on a cycle of white noise. On the
+ * target the delay lines are in PSRAM, if there is one, like in the real application.
+ */
+static const dsp_delay_values_t bench_delay_values = {
+    .delay    = 0.015f,
+    .depth    = 0.004f,
+    .rate     = 0.8f,
+    .feedback = 0.2f,
+    .mix      = 0.35f,
+};
+
+static void bench_delay(bench_clock_ptr clock, const char* unit, size_t n_samples) {
+    dsp_delay_t* delay = dsp_delay_new(0.04f);
+    if (!delay) {
+        printf("dsp_delay_process: skipped, not enough memory\n");
+        return;
+    }
+
+    dsp_delay_set_values(delay, &bench_delay_values);
+
+    static dsp_sample_t buffer[CONFIG_AUDIO_N_SAMPLES_CYCLE];
+
+    for (size_t i = 0; i < CONFIG_AUDIO_N_SAMPLES_CYCLE; i++) {
+#if CONFIG_DSP_ENGINE_FLOAT
+        buffer[i] = (rand() & 0xffff) * (1.0f / 65536.0f) - 0.5f;
+#else
+        buffer[i] = (rand() & 0xffff) - 0x8000;
+#endif
+    }
+
+    uint64_t start = clock();
+
+    for (size_t i = 0; i < n_samples; i += CONFIG_AUDIO_N_SAMPLES_CYCLE) {
+        dsp_delay_process(delay, buffer, CONFIG_AUDIO_N_SAMPLES_CYCLE);
+    }
+
+    size_t n = n_samples / CONFIG_AUDIO_N_SAMPLES_CYCLE * CONFIG_AUDIO_N_SAMPLES_CYCLE;
+    bench_report(delay->psram ? "dsp_delay_process (PSRAM)" : "dsp_delay_process", clock() - start, n / 2, unit, "frame");
+    bench_yield();
+
+    bench_sink = (int32_t) buffer[0];
+    dsp_delay_free(delay);
+}
+
+/**
+ * Synthesizer instance with the same sound as the default patch in `main.c`.
+ */
+static synth_t* bench_synth_new() {
+    float fm_ratios[] = {1.0f};
+
+    synth_config_t synth_config = {
+        .volume    = 1.0f,
+        .wavetable = dsp_wavetable_get(DSP_WAVETABLE_COS),
+
+        .env1 = {
+            .attack  = 0.1f,
+            .peak    = 1.0f,
+            .decay   = 0.3f,
+            .sustain = 0.5f,
+            .release = 0.5f,
+        },
+
+        .env2 = {
+            .attack  = 0.5f,
+            .peak    = 1.0f,
+            .decay   = 0.0f,
+            .sustain = 1.0f,
+            .release = 0.2f,
+        },
+
+        .fm = {
+            .n_ratios  = sizeof(fm_ratios) / sizeof(float),
+            .ratios    = fm_ratios,
+            .index_min = 0.25f,
+            .index_max = 0.75f,
+        },
+
+        .seed = BENCH_SEED,
+    };
+
+    return synth_new(&synth_config);
+}
+
+/**
+ * Complete synthesizer with the given number of sounding voices. The notes are
+ * never released, so that all voices sound for the whole measurement.
+ */
+static void bench_synth(bench_clock_ptr clock, const char* unit, size_t n_samples, int n_voices) {
+    synth_t* synth = bench_synth_new();
+
+    for (int i = 0; i < n_voices; i++) {
+        synth_note_on(synth, 36 + i * 2, 1.0f);
+    }
+
+    static dsp_sample_t buffer[CONFIG_AUDIO_N_SAMPLES_CYCLE];
+    uint64_t start = clock();
+
+    for (size_t i = 0; i < n_samples; i += CONFIG_AUDIO_N_SAMPLES_CYCLE) {
+        dsp_mix_clear(buffer, CONFIG_AUDIO_N_SAMPLES_CYCLE);
+        synth_process(synth, buffer, CONFIG_AUDIO_N_SAMPLES_CYCLE);
+    }
+
+    uint64_t time = clock() - start;
+    size_t   n    = n_samples / CONFIG_AUDIO_N_SAMPLES_CYCLE * CONFIG_AUDIO_N_SAMPLES_CYCLE;
+
+    char name[48];
+    snprintf(name, sizeof(name), "synth_process (%i voices)", n_voices);
+    bench_report(name, time, n / 2, unit, "frame");
+
+    snprintf(name, sizeof(name), "synth_process (%i voices) per voice", n_voices);
+    bench_report(name, time, n / 2 * n_voices, unit, "frame");
+    bench_yield();
+
+    bench_sink = (int32_t) buffer[0];
+    synth_free(synth);
+}
+
+/**
+ * Note-on and note-off with all voices sounding, so that each note-on must steal a
+ * voice. This should take the same time for any polyphony.
+ */
+static void bench_note_on(bench_clock_ptr clock, const char* unit, size_t n_samples) {
+    synth_t* synth = bench_synth_new();
+
+    for (int i = 0; i < CONFIG_SYNTH_POLYPHONY; i++) {
+        synth_note_on(synth, i, 1.0f);
+    }
+
+    size_t   n     = n_samples / BENCH_BLOCK;
+    uint64_t start = clock();
+
+    for (size_t i = 0; i < n; i++) {
+        synth_note_on(synth, i & 127, 1.0f);
+        synth_note_off(synth, (i + 64) & 127);
+    }
+
+    char name[48];
+    snprintf(name, sizeof(name), "synth_note_on (%i voices)", CONFIG_SYNTH_POLYPHONY);
+    bench_report(name, clock() - start, n, unit, "note");
+    bench_yield();
+
+    synth_free(synth);
+}
+
+/**
+ * Offline render of the whole DSP task without the I²S pacing. Uses the same processing
+ * cycle as the DSP task, only the sequencer has a fixed seed.
+ */
+uint32_t bench_render(bench_clock_ptr clock, uint64_t clock_hz, float seconds, bench_output_ptr output, void* arg) {
+    synth_t*       synth  = bench_synth_new();
+    event_queue_t* events = event_queue_new(CONFIG_EVENT_QUEUE_LENGTH);
+    int            notes[] = {60, 62, 64, 65, 67, 69, 71, 72};
+
+    sequencer_config_t sequencer_config = {
+        .events  = events,
+        .n_notes = sizeof(notes) / sizeof(int),
+        .notes   = notes,
+        .seed    = BENCH_SEED,
+    };
+
+    sequencer_t* sequencer = sequencer_new(&sequencer_config);
+    sequencer_set_bpm(sequencer, 80);
+    sequencer_set_running(sequencer, true);
+
+    dsp_delay_t* delay = NULL;
+
+#if CONFIG_EFFECT_DELAY_ENABLE
+    delay = dsp_delay_new(CONFIG_EFFECT_DELAY_MAX_MS / 1000.0f);
+    if (delay) dsp_delay_set_values(delay, &bench_delay_values);
+#endif
+
+    render_config_t render_config = {
+        .synth            = synth,
+        .sequencer        = sequencer,
+        .delay            = delay,
+        .sequencer_events = events,
+    };
+
+    render_t* render = render_new(&render_config);
+
+    static audiohw_sample_t slots[CONFIG_AUDIO_N_SAMPLES_CYCLE];
+    static int16_t          samples[CONFIG_AUDIO_N_SAMPLES_CYCLE];
+
+    size_t   n_cycles   = (size_t) (seconds * CONFIG_AUDIO_SAMPLE_RATE * 2 / CONFIG_AUDIO_N_SAMPLES_CYCLE);
+    uint32_t checksum   = 2166136261u;
+    int      max_voices = 0;
+    uint64_t render_time = 0;
+
+    for (size_t cycle = 0; cycle < n_cycles; cycle++) {
+        uint64_t start = clock();
+
+        if (!render_cycle(render, slots, CONFIG_AUDIO_N_SAMPLES_CYCLE)) {
+            memset(slots, 0, sizeof(slots));
+        }
+
+        render_time += clock() - start;
+
+        // The checksum and WAV file always use 16-bit samples, 32-bit slots are left-justified
+        for (size_t i = 0; i < CONFIG_AUDIO_N_SAMPLES_CYCLE; i++) {
+            samples[i] = (int16_t) (slots[i] >> (8 * sizeof(audiohw_sample_t) - 16));
+        }
+
+        // FNV-1a over the little-endian bytes of the samples
+        for (size_t i = 0; i < CONFIG_AUDIO_N_SAMPLES_CYCLE; i++) {
+            checksum = (checksum ^ (uint8_t) samples[i]) * 16777619u;
+            checksum = (checksum ^ (uint8_t) (samples[i] >> 8)) * 16777619u;
+        }
+
+        if (synth->state.n_active > max_voices) max_voices = synth->state.n_active;
+        if (output) output(samples, CONFIG_AUDIO_N_SAMPLES_CYCLE, arg);
+        if ((cycle & 1023) == 1023) bench_yield();
+    }
+
+    float audio_s  = (float) n_cycles * CONFIG_AUDIO_N_SAMPLES_CYCLE / 2 / CONFIG_AUDIO_SAMPLE_RATE;
+    float render_s = (float) render_time / clock_hz;
+
+    printf("render: %.1f s of audio in %.2f s, %.1fx realtime at up to %i voices, checksum %08" PRIx32 "\n",
+        audio_s, render_s, render_s > 0.0f ? audio_s / render_s : 0.0f, max_voices, checksum);
+
+    render_free(render);
+    if (delay) dsp_delay_free(delay);
+    sequencer_free(sequencer);
+    event_queue_free(events);
+    synth_free(synth);
+
+    return checksum;
+}
+
+/**
+ * Run all benchmark scenarios.
+ */
+void bench_run(bench_clock_ptr clock, const char* unit, size_t n_samples) {
+#if CONFIG_DSP_ENGINE_FIXED
+    printf("Benchmark: DSP engine fixed point, %u samples per scenario\n", (unsigned) n_samples);
+#elif CONFIG_DSP_ENGINE_LOG
+    printf("Benchmark: DSP engine log/exp, %u samples per scenario\n", (unsigned) n_samples);
+#else
+    printf("Benchmark: DSP engine float, %u samples per scenario\n", (unsigned) n_samples);
+#endif
+
+    srand(1);
+
+    bench_oscil(clock, unit, n_samples);
+    bench_adsr(clock, unit, n_samples);
+    bench_pan(clock, unit, n_samples);
+    bench_delay(clock, unit, n_samples);
+
+    for (int i = 0; i < sizeof(bench_voices) / sizeof(int); i++) {
+        if (bench_voices[i] > CONFIG_SYNTH_POLYPHONY) {
+            printf("synth_process (%i voices): skipped, polyphony is %i\n", bench_voices[i], CONFIG_SYNTH_POLYPHONY);
+            continue;
+        }
+
+        bench_synth(clock, unit, n_samples, bench_voices[i]);
+    }
+
+    bench_note_on(clock, unit, n_samples);
+}
+
+#if CONFIG_BENCH_ON_TARGET
+/**
+ * CPU cycle counter extended to 64 bits. The 32-bit counter wraps around every
+ * 18 seconds at 240 MHz, which is much longer than the time between two calls.
+ */
+static uint64_t bench_clock_cycles() {
+    static uint32_t last = 0;
+    static uint64_t high = 0;
+
+    uint32_t now = esp_cpu_get_cycle_count();
+    if (now < last) high += 1ULL << 32;
+    last = now;
+
+    return high | now;
+}
+
+/**
+ * Run all benchmark scenarios on the target.
+ */
+void bench_run_on_target() {
+    bench_run(bench_clock_cycles, "cycles", CONFIG_BENCH_N_SAMPLES);
+    bench_render(bench_clock_cycles, CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ * 1000000ULL, CONFIG_BENCH_RENDER_SECONDS, NULL, NULL);
+}
+#endif
@@ -0,0 +1,65 @@
+/*
+ * Klimper: ESP32 I²S Synthesizer Test
+ * © 2024 Dennis Schulmeister-Zimolong <dennis@wpvs.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ */
+
+#pragma once
+
+#include <stddef.h>                         // size_t
+#include <stdint.h>                         // int16_t, uint32_t, uint64_t
+#include "sdkconfig.h"                      // CONFIG_BENCH_ON_TARGET
+
+/**
+ * Clock function for the benchmarks. Returns a monotonic time stamp in an arbitrary
+ * unit, e.g. nanoseconds on the host or CPU cycles on the target.
+ */
+typedef uint64_t (*bench_clock_ptr)();
+
+/**
+ * Output function for the offline render, e.g. to write a WAV file on the host. Called
+ * once per processing cycle with interleaved 16-bit stereo samples.
+ */
+typedef void (*bench_output_ptr)(const int16_t* samples, size_t n, void* arg);
+
+/**
+ * Run all benchmark scenarios and print the results to stdout: The tick functions
+ * of the configured DSP engine (oscillator, envelope generator, pan law) and the
+ * synthesizer with 1, 4, 8, 16 and 32 sounding voices, as far as the configured
+ * polyphony allows. The same scenarios are used on the host and on the target,
+ * so that the results can be compared.
+ *
+ * @param clock Clock function
+ * @param unit Name of the clock unit (e.g. "ns" or "cycles")
+ * @param n_samples Number of samples per scenario
+ */
+void bench_run(bench_clock_ptr clock, const char* unit, size_t n_samples);
+
+/**
+ * Render the sequencer, synthesizer and effects with a fixed random seed as fast as
+ * possible, without the pacing of the I²S interrupt, and print the realtime factor.
+ * The result is the same for each run of the same firmware build, so that the checksum
+ * (FNV-1a over the 16-bit samples) or the output can be compared bit for bit after
+ * performance optimizations.
+ *
+ * @param clock Clock function
+ * @param clock_hz Clock ticks per second
+ * @param seconds Length of the rendered audio in seconds
+ * @param output Output function for the rendered samples (`NULL` for the checksum only)
+ * @param arg User argument for the output function
+ * @returns Checksum of the rendered samples
+ */
+uint32_t bench_render(bench_clock_ptr clock, uint64_t clock_hz, float seconds, bench_output_ptr output, void* arg);
+
+#if CONFIG_BENCH_ON_TARGET
+/**
+ * Run all benchmark scenarios on the target with the CPU cycle counter as clock
+ * and `CONFIG_BENCH_N_SAMPLES` samples per scenario, followed by an offline render
+ * of `CONFIG_BENCH_RENDER_SECONDS` seconds.
+ */
+void bench_run_on_target();
+#endif
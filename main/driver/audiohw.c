@@ -11,32 +11,50 @@
 #include "audiohw.h"
 
 #include <driver/i2s_std.h>                     // i2s…()
+#include <esp_err.h>                            // ESP_ERROR_CHECK()
 #include <esp_log.h>                            // ESP_LOGx
+#include <esp_timer.h>                          // esp_timer_get_time()
+#include <freertos/queue.h>                     // QueueHandle_t, xQueue…()
+#include "../trace.h"                           // trace_record()
+
+#if CONFIG_AUDIO_N_SAMPLES_BUFFER * 2 * (CONFIG_AUDIO_I2S_32BIT ? 2 : 1) > 4092
+    #error The DMA buffers exceed the maximum size of 4092 bytes of the I²S driver!
+#endif
+
+#if CONFIG_AUDIO_N_SAMPLES_CYCLE % 2 || CONFIG_AUDIO_N_SAMPLES_BUFFER % 2
+    #error The processing cycle and the DMA buffers must have an even number of samples, since two samples make one stereo frame!
+#endif
 
 static const char* TAG = "audiohw";             // Logging tag
 
 static bool i2s_isr_on_sent(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx);
 
-static TaskHandle_t dsp_task;                   // DSP task to notify
-static audiohw_buffer_t audiohw_buffer = {};    // Buffer information passed to mixer task
+static QueueHandle_t audiohw_queue;             // Sent DMA buffers waiting to be filled
+static volatile uint32_t audiohw_overruns = 0;  // DMA buffers dropped because the queue was full
 static i2s_chan_handle_t tx_handle;             // I²S Transmit Handle
 
 /**
  * Initialize audio hardware layer.
  */
 void audiohw_init(audiohw_config_t* config) {
-    dsp_task = config->dsp_task;
+    // One queue entry per DMA buffer, so that the queue can only overflow if the
+    // DSP task is so late that the DMA controller already wraps around
+    audiohw_queue = xQueueCreate(config->n_buffers, sizeof(audiohw_buffer_t));
 
     i2s_chan_config_t channel_config = I2S_CHANNEL_DEFAULT_CONFIG(I2S_NUM_AUTO, I2S_ROLE_MASTER);
-    channel_config.auto_clear_before_cb = true;
-    channel_config.auto_clear_after_cb  = true;
-    channel_config.dma_desc_num         = 2;                            // Two buffers
-    channel_config.dma_frame_num        = config->n_samples / 2;        // Samples per buffer
-    i2s_new_channel(&channel_config, &tx_handle, NULL);
+    channel_config.auto_clear_before_cb = false;                        // Buffers are completely
+    channel_config.auto_clear_after_cb  = false;                        // overwritten by the DSP task
+    channel_config.dma_desc_num         = config->n_buffers;            // Number of buffers
+    channel_config.dma_frame_num        = config->n_samples / 2;        // Stereo frames per buffer
+    ESP_ERROR_CHECK(i2s_new_channel(&channel_config, &tx_handle, NULL));
 
     i2s_std_config_t standard_config = {
         .clk_cfg  = I2S_STD_CLK_DEFAULT_CONFIG(config->sample_rate),
+#if CONFIG_AUDIO_I2S_32BIT
+        .slot_cfg = I2S_STD_MSB_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_32BIT, I2S_SLOT_MODE_STEREO),
+#else
         .slot_cfg = I2S_STD_MSB_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT, I2S_SLOT_MODE_STEREO),
+#endif
 
         .gpio_cfg = {
             .mclk = config->i2s_mck_io,
@@ -53,14 +71,14 @@ void audiohw_init(audiohw_config_t* config) {
         },
     };
 
-    i2s_channel_init_std_mode(tx_handle, &standard_config);
+    ESP_ERROR_CHECK(i2s_channel_init_std_mode(tx_handle, &standard_config));
 
     i2s_event_callbacks_t callbacks = {
         .on_sent = i2s_isr_on_sent,
     };
 
-    i2s_channel_register_event_callback(tx_handle, &callbacks, NULL);
-    i2s_channel_enable(tx_handle);
+    ESP_ERROR_CHECK(i2s_channel_register_event_callback(tx_handle, &callbacks, NULL));
+    ESP_ERROR_CHECK(i2s_channel_enable(tx_handle));
 
     // Print buffer and latency information
     i2s_chan_info_t channel_info = {};
@@ -73,10 +91,12 @@ void audiohw_init(audiohw_config_t* config) {
         uint32_t n_frames = channel_info.total_dma_buf_size / channel_config.dma_desc_num / standard_config.slot_cfg.slot_mode / standard_config.slot_cfg.data_bit_width * 8;
         float latency_ms = 1000.0 * n_frames / standard_config.clk_cfg.sample_rate_hz;
 
-        ESP_LOGI(TAG, "I²S Sample Rate............: %i Hz", CONFIG_AUDIO_SAMPLE_RATE);
-        ESP_LOGI(TAG, "I²S Samples per Buffer.....: %i (containing two audio channels)", CONFIG_AUDIO_N_SAMPLES_BUFFER);
+        ESP_LOGI(TAG, "I²S Sample Rate............: %i Hz", config->sample_rate);
+        ESP_LOGI(TAG, "I²S Samples per Buffer.....: %i (containing two audio channels)", (int) config->n_samples);
+        ESP_LOGI(TAG, "I²S Number of Buffers......: %" PRIu32, channel_config.dma_desc_num);
         ESP_LOGI(TAG, "I²S Resulting DMA Buffer...: %" PRIu32 " Bytes", channel_info.total_dma_buf_size);
-        ESP_LOGI(TAG, "I²S Resulting Latency......: %f ms", latency_ms);
+        ESP_LOGI(TAG, "I²S Time per Buffer........: %f ms", latency_ms);
+        ESP_LOGI(TAG, "I²S Resulting Latency......: %f ms", latency_ms * channel_config.dma_desc_num);
     } else {
         // That should not happen!
         ESP_LOGE(TAG, "Cannot calculate I2S latency due to division by zero.");
@@ -84,20 +104,38 @@ void audiohw_init(audiohw_config_t* config) {
 }
 
 /**
- * ISR being triggered automatically when new audio data must be created.
+ * Wait for the next DMA buffer to fill.
+ */
+bool audiohw_next_buffer(audiohw_buffer_t* buffer, TickType_t timeout) {
+    return xQueueReceive(audiohw_queue, buffer, timeout) == pdTRUE;
+}
+
+/**
+ * Get number of DMA buffer overruns.
+ */
+uint32_t audiohw_get_overruns() {
+    return audiohw_overruns;
+}
+
+/**
+ * ISR being triggered automatically when new audio data must be created. Unlike a task
+ * notification the queue doesn't silently overwrite a buffer the DSP task has not yet
+ * taken. Instead the overrun is counted.
  */
 static IRAM_ATTR bool i2s_isr_on_sent(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx) {
-    audiohw_buffer.data = event->dma_buf;
-    audiohw_buffer.size = event->size;
+    audiohw_buffer_t buffer = {
+        .size      = event->size / sizeof(audiohw_sample_t),
+        .data      = event->dma_buf,
+        .queued_us = esp_timer_get_time(),
+    };
 
     BaseType_t higherPriorityTaskWoken = pdFALSE;
 
-    xTaskNotifyFromISR(
-        /* xTaskToNotify            */ dsp_task,
-        /* ulValue                  */ (uint32_t) &audiohw_buffer,
-        /* eAction                  */ eSetValueWithOverwrite,
-        /* xHigherPriorityTaskWoken */ &higherPriorityTaskWoken
-    );
+    if (xQueueSendFromISR(audiohw_queue, &buffer, &higherPriorityTaskWoken) != pdTRUE) {
+        audiohw_overruns++;
+    }
+
+    trace_record(TRACE_I2S_ISR, (uint16_t) audiohw_overruns);
 
     // See: https://www.freertos.org/RTOS_Task_Notification_As_Binary_Semaphore.html
     // Trigger immediate context switch if needed to return to the highest priority task
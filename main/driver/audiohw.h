@@ -1,7 +1,7 @@
 /*
  * Klimper: ESP32 I²S Synthesizer Test
  * © 2024 Dennis Schulmeister-Zimolong <dennis@wpvs.de>
- * 
+ *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU Affero General Public License as
  * published by the Free Software Foundation, either version 3 of the
@@ -11,37 +11,70 @@
 #pragma once
 
 #include <freertos/FreeRTOS.h>              // Common FreeRTOS (must come first)
-#include <freertos/task.h>                  // TaskHandle_t
-#include <stdint.h>                         // int16_t
+#include <stdbool.h>                        // bool, true, false
+#include <stddef.h>                         // size_t
+#include <stdint.h>                         // int16_t, int32_t, uint32_t
+#include "sdkconfig.h"                      // CONFIG_AUDIO_I2S_32BIT
+
+/**
+ * Sample format of the I²S slots and thus of the DMA buffers. 32-bit samples are
+ * left-justified, i.e. a 16-bit sample is simply shifted by 16 bits.
+ */
+#if CONFIG_AUDIO_I2S_32BIT
+    typedef int32_t audiohw_sample_t;
+#else
+    typedef int16_t audiohw_sample_t;
+#endif
 
 /**
  * Configuration parameters for audio output.
  */
 typedef struct {
     int          sample_rate;               // Sample rate in Hz
-    size_t       n_samples;                 // Number of samples per buffer (do determine latency)
+    size_t       n_samples;                 // Number of samples per DMA buffer
+    size_t       n_buffers;                 // Number of DMA buffers (together with n_samples determines latency)
     int          i2s_mck_io;                // I²S Master Clock
     int          i2s_bck_io;                // I²S Bit Clock
     int          i2s_lrc_io;                // I²S Left/Right Clock
     int          i2s_dout_io;               // I²S Data Output
-    TaskHandle_t dsp_task;                  // DSP Task
 } audiohw_config_t;
 
 /**
- * Callback structure passed to the mixing task to inform it about where
- * and how many audio samples to put. A pointer to this structure is passed
- * as "notification value" to the mixing task.
+ * DMA buffer that has just been sent and must be filled with new audio data.
+ * The ISR puts these into a queue, from which they are taken by the DSP task
+ * with `audiohw_next_buffer()`.
  */
 typedef struct {
-    size_t   size;                          // Buffer size
-    int16_t* data;                          // Transmit buffer
+    size_t            size;                 // Number of samples (two per stereo frame)
+    audiohw_sample_t* data;                 // Transmit buffer
+    int64_t           queued_us;            // System time when the ISR queued the buffer
 } audiohw_buffer_t;
 
 /**
- * Initialize audio hardware. Initializes the I²S driver and installs an
- * ISR to pull new audio data to be played. The ISR sends a notification
- * to an external DSP task that provides the actual audio data.
- * 
+ * Initialize audio hardware. Initializes the I²S driver with a ring of DMA buffers and
+ * installs an ISR that puts each buffer into a queue once it has been sent. An external
+ * DSP task must take the buffers from the queue and fill them with new audio data before
+ * the DMA controller reaches them again. The driver doesn't clear the buffers, since
+ * they are completely overwritten anyway.
+ *
  * @param config Configuration parameters (can be freed afterwards)
  */
 void audiohw_init(audiohw_config_t* config);
+
+/**
+ * Wait for the next DMA buffer that must be filled with audio data.
+ *
+ * @param buffer [out] Buffer information
+ * @param timeout Maximum time to wait in ticks (`portMAX_DELAY` to wait forever)
+ * @returns `true` if a buffer was received, `false` on timeout
+ */
+bool audiohw_next_buffer(audiohw_buffer_t* buffer, TickType_t timeout);
+
+/**
+ * Get the number of DMA buffers, that could not be queued because the DSP task
+ * had not taken them out of the queue in time. Each overrun means that old audio
+ * data has been played again.
+ *
+ * @returns Number of overruns since initialization
+ */
+uint32_t audiohw_get_overruns();
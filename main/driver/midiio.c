@@ -9,3 +9,69 @@
  */
 
 #include "midiio.h"
+
+#include <driver/uart.h>                        // uart_…()
+#include <esp_err.h>                            // ESP_ERROR_CHECK()
+#include <esp_log.h>                            // ESP_LOGx
+#include <freertos/queue.h>                     // QueueHandle_t, xQueueReceive()
+
+static const char* TAG = "midiio";              // Logging tag
+
+static int           midiio_uart = -1;          // UART port number
+static QueueHandle_t midiio_queue;              // UART driver events (only used to count overflows)
+static uint32_t      midiio_overflows = 0;      // Number of FIFO or ring buffer overflows
+
+/**
+ * Initialize MIDI hardware layer.
+ */
+void midiio_init(midiio_config_t* config) {
+    midiio_uart = config->uart_num;
+
+    uart_config_t uart_config = {
+        .baud_rate  = MIDIIO_BAUD_RATE,
+        .data_bits  = UART_DATA_8_BITS,
+        .parity     = UART_PARITY_DISABLE,
+        .stop_bits  = UART_STOP_BITS_1,
+        .flow_ctrl  = UART_HW_FLOWCTRL_DISABLE,
+        .source_clk = UART_SCLK_DEFAULT,
+    };
+
+    ESP_ERROR_CHECK(uart_driver_install(midiio_uart, config->rx_buffer_size, 0, 8, &midiio_queue, 0));
+    ESP_ERROR_CHECK(uart_param_config(midiio_uart, &uart_config));
+    ESP_ERROR_CHECK(uart_set_pin(midiio_uart, UART_PIN_NO_CHANGE, config->rx_io, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
+
+    // Interrupt on every received byte instead of waiting for the FIFO to fill up
+    // or the receive timeout. A MIDI byte takes 320 µs, so this is cheap.
+    ESP_ERROR_CHECK(uart_set_rx_full_threshold(midiio_uart, 1));
+
+    ESP_LOGI(TAG, "MIDI input on UART %i, RX GPIO %i, %i bytes ring buffer", midiio_uart, config->rx_io, (int) config->rx_buffer_size);
+}
+
+/**
+ * Read received MIDI bytes.
+ */
+size_t midiio_read(uint8_t* data, size_t length) {
+    // Count overflows reported by the UART driver without waiting for events. The ring
+    // buffer is not flushed, since it holds complete messages (e.g. note-offs), and is
+    // drained below anyway. The parser resyncs at the next status byte.
+    uart_event_t event;
+
+    while (xQueueReceive(midiio_queue, &event, 0) == pdTRUE) {
+        if (event.type == UART_FIFO_OVF || event.type == UART_BUFFER_FULL) midiio_overflows++;
+    }
+
+    size_t available = 0;
+    uart_get_buffered_data_len(midiio_uart, &available);
+    if (available == 0) return 0;
+    if (available > length) available = length;
+
+    int n = uart_read_bytes(midiio_uart, data, available, 0);
+    return n > 0 ? n : 0;
+}
+
+/**
+ * Get number of overflows.
+ */
+uint32_t midiio_get_overflows() {
+    return midiio_overflows;
+}
@@ -9,3 +9,44 @@
  */
 
 #pragma once
+
+#include <stddef.h>                         // size_t
+#include <stdint.h>                         // uint8_t
+
+#define MIDIIO_BAUD_RATE (31250)            // MIDI 1.0 serial bit rate
+
+/**
+ * Configuration parameters for MIDI input.
+ */
+typedef struct {
+    int    uart_num;                        // UART port number
+    int    rx_io;                           // MIDI In (UART RX)
+    size_t rx_buffer_size;                  // Size of the receive ring buffer in bytes
+} midiio_config_t;
+
+/**
+ * Initialize MIDI hardware. Installs the UART driver with 31250 baud, 8N1. The UART
+ * interrupt moves each received byte into a ring buffer right away, from which it can
+ * be read without blocking at the beginning of each processing cycle. Thus no extra
+ * task is involved, whose scheduling would add to the latency.
+ *
+ * @param config Configuration parameters (can be freed afterwards)
+ */
+void midiio_init(midiio_config_t* config);
+
+/**
+ * Read the MIDI bytes received so far. Never blocks.
+ *
+ * @param data [out] Buffer for the received bytes
+ * @param length Size of the buffer
+ * @returns Number of bytes read (zero if nothing has been received)
+ */
+size_t midiio_read(uint8_t* data, size_t length);
+
+/**
+ * Get the number of received bytes that were lost, because the ring buffer or the
+ * hardware FIFO overflowed.
+ *
+ * @returns Number of overflows since initialization
+ */
+uint32_t midiio_get_overflows();
@@ -10,13 +10,26 @@
 
 #include "adsr.h"
 
-#include <stdlib.h>                         // calloc(), malloc(), free()
+#include <esp_attr.h>                       // IRAM_ATTR
+#include <stdbool.h>                        // bool, true, false
+#include <stdlib.h>                         // malloc(), free()
+#include <string.h>                         // memset()
 
 /**
  * Create a new ADSR envelope generator.
  */
 dsp_adsr_t* dsp_adsr_new() {
-    return calloc(1, sizeof(dsp_adsr_t));
+    dsp_adsr_t* adsr = malloc(sizeof(dsp_adsr_t));
+    dsp_adsr_init(adsr);
+    return adsr;
+}
+
+/**
+ * Initialize ADSR envelope generator in place.
+ */
+void dsp_adsr_init(dsp_adsr_t* adsr) {
+    memset(adsr, 0, sizeof(dsp_adsr_t));
+    adsr->state.value_log = DSP_LOG_SILENCE << 16;
 }
 
 /**
@@ -53,6 +66,34 @@ static inline void dsp_adsr_recalc_increments(dsp_adsr_t* adsr) {
     nsmpl = CONFIG_AUDIO_SAMPLE_RATE * adsr->envelope.release.duration;
     if (nsmpl < nsmpl_min) nsmpl = nsmpl_min;
     adsr->envelope.release.increment = delta / nsmpl;
+
+    // Fixed-point copies of the same values
+    adsr->envelope.attack.value_q31      = dsp_q31_from_float(adsr->envelope.attack.value);
+    adsr->envelope.attack.increment_q31  = dsp_q31_from_float(adsr->envelope.attack.increment);
+    adsr->envelope.decay.value_q31       = dsp_q31_from_float(adsr->envelope.decay.value);
+    adsr->envelope.decay.increment_q31   = dsp_q31_from_float(adsr->envelope.decay.increment);
+    adsr->envelope.release.value_q31     = dsp_q31_from_float(adsr->envelope.release.value);
+    adsr->envelope.release.increment_q31 = dsp_q31_from_float(adsr->envelope.release.increment);
+
+    // Log-domain attenuations, linearly interpolated between silence, peak and sustain
+    adsr->envelope.attack.value_log  = dsp_log_from_float(adsr->envelope.attack.value) << 16;
+    adsr->envelope.decay.value_log   = dsp_log_from_float(adsr->envelope.decay.value) << 16;
+    adsr->envelope.release.value_log = DSP_LOG_SILENCE << 16;
+
+    delta = adsr->envelope.attack.value_log - adsr->envelope.release.value_log;
+    nsmpl = CONFIG_AUDIO_SAMPLE_RATE * adsr->envelope.attack.duration;
+    if (nsmpl < nsmpl_min) nsmpl = nsmpl_min;
+    adsr->envelope.attack.increment_log = (int32_t) (delta / nsmpl);
+
+    delta = adsr->envelope.decay.value_log - adsr->envelope.attack.value_log;
+    nsmpl = CONFIG_AUDIO_SAMPLE_RATE * adsr->envelope.decay.duration;
+    if (nsmpl < nsmpl_min) nsmpl = nsmpl_min;
+    adsr->envelope.decay.increment_log = (int32_t) (delta / nsmpl);
+
+    delta = adsr->envelope.release.value_log - adsr->envelope.decay.value_log;
+    nsmpl = CONFIG_AUDIO_SAMPLE_RATE * adsr->envelope.release.duration;
+    if (nsmpl < nsmpl_min) nsmpl = nsmpl_min;
+    adsr->envelope.release.increment_log = (int32_t) (delta / nsmpl);
 }
 
 /**
@@ -139,3 +180,189 @@ void dsp_adsr_trigger_attack(dsp_adsr_t* adsr) {
 void dsp_adsr_trigger_release(dsp_adsr_t* adsr) {
     adsr->state.status = DSP_ADSR_RELEASE;
 }
+
+/**
+ * Stop the envelope and jump to zero.
+ */
+void dsp_adsr_stop(dsp_adsr_t* adsr) {
+    adsr->state.status    = DSP_ADSR_STOPPED;
+    adsr->state.value     = 0.0f;
+    adsr->state.value_q31 = 0;
+    adsr->state.value_log = DSP_LOG_SILENCE << 16;
+}
+
+#if CONFIG_DSP_ADSR_RAMP_LENGTH > 1
+/**
+ * Try to render a linear ramp of `n` samples without any segment transition. Since the
+ * segments are monotonic, the ramp is valid if its last value has not yet reached the
+ * next breakpoint. The float version must render the ramp to find out, because the
+ * rounding errors of the accumulation cannot be predicted exactly.
+ *
+ * @returns `false` when a transition would happen and nothing has been changed
+ */
+static inline bool dsp_adsr_ramp(dsp_adsr_t* adsr, float* output, size_t n) {
+    float value = adsr->state.value;
+    float increment;
+
+    switch (adsr->state.status) {
+        case DSP_ADSR_ATTACK:  increment = adsr->envelope.attack.increment;  break;
+        case DSP_ADSR_DECAY:   increment = adsr->envelope.decay.increment;   break;
+        case DSP_ADSR_RELEASE: increment = adsr->envelope.release.increment; break;
+        default:               increment = 0.0f;                             break;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        output[i] = value;
+        value += increment;
+    }
+
+    switch (adsr->state.status) {
+        case DSP_ADSR_ATTACK:  if (value >= adsr->envelope.attack.value) return false; break;
+        case DSP_ADSR_DECAY:   if (value <= adsr->envelope.decay.value)  return false; break;
+        case DSP_ADSR_RELEASE: if (value <= 0.0f)                        return false; break;
+        default:                                                                       break;
+    }
+
+    adsr->state.value = value;
+    return true;
+}
+
+/**
+ * Fixed-point version of `dsp_adsr_ramp()`. Integer accumulation is exact, so the
+ * segment transition can be checked before the ramp is rendered.
+ */
+static inline bool dsp_adsr_ramp_q15(dsp_adsr_t* adsr, q15_t* output, size_t n) {
+    q31_t value = adsr->state.value_q31;
+    q31_t increment;
+
+    switch (adsr->state.status) {
+        case DSP_ADSR_ATTACK:
+            increment = adsr->envelope.attack.increment_q31;
+            if (value + (int64_t) n * increment >= adsr->envelope.attack.value_q31) return false;
+            break;
+        case DSP_ADSR_DECAY:
+            increment = adsr->envelope.decay.increment_q31;
+            if (value + (int64_t) n * increment <= adsr->envelope.decay.value_q31) return false;
+            break;
+        case DSP_ADSR_RELEASE:
+            increment = adsr->envelope.release.increment_q31;
+            if (value + (int64_t) n * increment <= 0) return false;
+            break;
+        default:
+            increment = 0;
+            break;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        output[i] = (q15_t) (value >> 16);
+        value += increment;
+    }
+
+    adsr->state.value_q31 = value;
+    return true;
+}
+
+/**
+ * Log-domain version of `dsp_adsr_ramp()`.
+ */
+static inline bool dsp_adsr_ramp_log(dsp_adsr_t* adsr, dsp_log_t* output, size_t n) {
+    int32_t value = adsr->state.value_log;
+    int32_t increment;
+
+    switch (adsr->state.status) {
+        case DSP_ADSR_ATTACK:
+            increment = adsr->envelope.attack.increment_log;
+            if (value + (int64_t) n * increment <= adsr->envelope.attack.value_log) return false;
+            break;
+        case DSP_ADSR_DECAY:
+            increment = adsr->envelope.decay.increment_log;
+            if (value + (int64_t) n * increment >= adsr->envelope.decay.value_log) return false;
+            break;
+        case DSP_ADSR_RELEASE:
+            increment = adsr->envelope.release.increment_log;
+            if (value + (int64_t) n * increment >= adsr->envelope.release.value_log) return false;
+            break;
+        default:
+            increment = 0;
+            break;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        output[i] = (dsp_log_t) (value >> 16);
+        value += increment;
+    }
+
+    adsr->state.value_log = value;
+    return true;
+}
+#endif
+
+/**
+ * Render a block of samples. Like the oscillators this works on a local copy, so that
+ * the envelope state can be kept in registers. With `CONFIG_DSP_ADSR_RAMP_LENGTH` the
+ * block is split into short linear ramps without any branches. Only the ramp containing
+ * a segment transition is calculated sample by sample, so that the transition happens
+ * at exactly the same sample as with `dsp_adsr_tick()`.
+ */
+void IRAM_ATTR dsp_adsr_process(dsp_adsr_t* adsr, float* output, size_t n) {
+    dsp_adsr_t local = *adsr;
+
+#if CONFIG_DSP_ADSR_RAMP_LENGTH > 1
+    for (size_t offset = 0; offset < n; offset += CONFIG_DSP_ADSR_RAMP_LENGTH) {
+        size_t length = n - offset;
+        if (length > CONFIG_DSP_ADSR_RAMP_LENGTH) length = CONFIG_DSP_ADSR_RAMP_LENGTH;
+
+        if (!dsp_adsr_ramp(&local, output + offset, length)) {
+            for (size_t i = 0; i < length; i++) output[offset + i] = dsp_adsr_tick(&local);
+        }
+    }
+#else
+    for (size_t i = 0; i < n; i++) output[i] = dsp_adsr_tick(&local);
+#endif
+
+    *adsr = local;
+}
+
+/**
+ * Fixed-point version of `dsp_adsr_process()`.
+ */
+void IRAM_ATTR dsp_adsr_process_q15(dsp_adsr_t* adsr, q15_t* output, size_t n) {
+    dsp_adsr_t local = *adsr;
+
+#if CONFIG_DSP_ADSR_RAMP_LENGTH > 1
+    for (size_t offset = 0; offset < n; offset += CONFIG_DSP_ADSR_RAMP_LENGTH) {
+        size_t length = n - offset;
+        if (length > CONFIG_DSP_ADSR_RAMP_LENGTH) length = CONFIG_DSP_ADSR_RAMP_LENGTH;
+
+        if (!dsp_adsr_ramp_q15(&local, output + offset, length)) {
+            for (size_t i = 0; i < length; i++) output[offset + i] = dsp_adsr_tick_q15(&local);
+        }
+    }
+#else
+    for (size_t i = 0; i < n; i++) output[i] = dsp_adsr_tick_q15(&local);
+#endif
+
+    *adsr = local;
+}
+
+/**
+ * Log-domain version of `dsp_adsr_process()`.
+ */
+void IRAM_ATTR dsp_adsr_process_log(dsp_adsr_t* adsr, dsp_log_t* output, size_t n) {
+    dsp_adsr_t local = *adsr;
+
+#if CONFIG_DSP_ADSR_RAMP_LENGTH > 1
+    for (size_t offset = 0; offset < n; offset += CONFIG_DSP_ADSR_RAMP_LENGTH) {
+        size_t length = n - offset;
+        if (length > CONFIG_DSP_ADSR_RAMP_LENGTH) length = CONFIG_DSP_ADSR_RAMP_LENGTH;
+
+        if (!dsp_adsr_ramp_log(&local, output + offset, length)) {
+            for (size_t i = 0; i < length; i++) output[offset + i] = dsp_adsr_tick_log(&local);
+        }
+    }
+#else
+    for (size_t i = 0; i < n; i++) output[i] = dsp_adsr_tick_log(&local);
+#endif
+
+    *adsr = local;
+}
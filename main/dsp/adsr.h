@@ -10,6 +10,9 @@
 
 #pragma once
 
+#include <stddef.h>                         // size_t
+#include "sample.h"                         // q15_t, q31_t
+
 /**
  * Status of the envelope generator, defined as whether it is stopped or which segment
  * of the envelope is currently being generated.
@@ -29,6 +32,10 @@ typedef struct {
     float value;                            // Target value
     float duration;                         // Duration in seconds
     float increment;                        // Value increment per sample rate tick
+    q31_t value_q31;                        // Fixed point: Target value
+    q31_t increment_q31;                    // Fixed point: Value increment per sample rate tick
+    int32_t value_log;                      // Log domain: Target attenuation (16 fractional bits)
+    int32_t increment_log;                  // Log domain: Attenuation increment per sample rate tick
 } dsp_adsr_breakpoint_t;
 
 /**
@@ -57,6 +64,8 @@ typedef struct {
     struct {
         dsp_adsr_status_t status;           // Currently active segment
         float             value;            // Next value
+        q31_t             value_q31;        // Fixed point: Next value
+        int32_t           value_log;        // Log domain: Next attenuation (16 fractional bits)
     } state;
 } dsp_adsr_t;
 
@@ -66,12 +75,27 @@ typedef struct {
  */
 dsp_adsr_t* dsp_adsr_new();
 
+/**
+ * Initialize an ADSR envelope generator in memory allocated by the caller, e.g. in
+ * an array of envelope generators. Same as `dsp_adsr_new()` without the allocation.
+ * Such an envelope generator must not be freed with `dsp_adsr_free()`.
+ *
+ * @param adsr ADSR envelope generator memory
+ */
+void dsp_adsr_init(dsp_adsr_t* adsr);
+
 /**
  * Free memory of a given ADSR envelope generator.
  * @param adsr ADSR envelope generator
  */
 void dsp_adsr_free(dsp_adsr_t* adsr);
 
+/**
+ * Stop the envelope immediately without a release. The next value will be zero.
+ * @param adsr ADSR envelope generator
+ */
+void dsp_adsr_stop(dsp_adsr_t* adsr);
+
 /**
  * Shortcut to set all values at once. Also saves some processing cycles, because
  * the value increments will only be recalculated once.
@@ -133,6 +157,35 @@ void dsp_adsr_trigger_attack(dsp_adsr_t* adsr);
  */
 void dsp_adsr_trigger_release(dsp_adsr_t* adsr);
 
+/**
+ * Render a block of samples. This is the same as calling `dsp_adsr_tick()` for each
+ * sample, but keeps the envelope state in registers for the whole block. Depending on
+ * `CONFIG_DSP_ADSR_RAMP_LENGTH` the block is rendered as branch-free linear ramps.
+ *
+ * @param adsr ADSR envelope generator
+ * @param output [out] Output samples
+ * @param n Number of samples
+ */
+void dsp_adsr_process(dsp_adsr_t* adsr, float* output, size_t n);
+
+/**
+ * Fixed-point version of `dsp_adsr_process()`.
+ *
+ * @param adsr ADSR envelope generator
+ * @param output [out] Q15 output samples
+ * @param n Number of samples
+ */
+void dsp_adsr_process_q15(dsp_adsr_t* adsr, q15_t* output, size_t n);
+
+/**
+ * Log-domain version of `dsp_adsr_process()`.
+ *
+ * @param adsr ADSR envelope generator
+ * @param output [out] Output attenuations
+ * @param n Number of samples
+ */
+void dsp_adsr_process_log(dsp_adsr_t* adsr, dsp_log_t* output, size_t n);
+
 /**
  * Calculate next sample.
  * @param adsr ADSR envelope generator
@@ -175,3 +228,98 @@ static inline float dsp_adsr_tick(dsp_adsr_t* adsr) {
 
     return value;
 }
+
+/**
+ * Fixed-point version of `dsp_adsr_tick()`: Calculate next sample. The envelope is
+ * accumulated with Q31 precision, as the increments of slow envelopes are too small
+ * for Q15. The comparisons are arranged so that the value never overflows.
+ *
+ * @param adsr ADSR envelope generator
+ * @returns Next Q15 sample
+ */
+static inline q15_t dsp_adsr_tick_q15(dsp_adsr_t* adsr) {
+    q31_t value = adsr->state.value_q31;
+
+    switch (adsr->state.status) {
+        case DSP_ADSR_ATTACK:
+            if (value >= adsr->envelope.attack.value_q31 - adsr->envelope.attack.increment_q31) {
+                adsr->state.status    = DSP_ADSR_DECAY;
+                adsr->state.value_q31 = adsr->envelope.attack.value_q31;
+            } else {
+                adsr->state.value_q31 += adsr->envelope.attack.increment_q31;
+            }
+
+            break;
+        case DSP_ADSR_DECAY:
+            if (value <= adsr->envelope.decay.value_q31 - adsr->envelope.decay.increment_q31) {
+                adsr->state.status    = DSP_ADSR_SUSTAIN;
+                adsr->state.value_q31 = adsr->envelope.decay.value_q31;
+            } else {
+                adsr->state.value_q31 += adsr->envelope.decay.increment_q31;
+            }
+
+            break;
+        case DSP_ADSR_RELEASE:
+            if (value <= -adsr->envelope.release.increment_q31) {
+                adsr->state.status    = DSP_ADSR_STOPPED;
+                adsr->state.value_q31 = 0;
+            } else {
+                adsr->state.value_q31 += adsr->envelope.release.increment_q31;
+            }
+
+            break;
+        default:
+            // Suppress compiler error: Enumeration value not handled in switch
+            break;
+    }
+
+    return (q15_t) (value >> 16);
+}
+
+/**
+ * Log-domain version of `dsp_adsr_tick()`: Calculate next attenuation, so that the
+ * envelope can be applied by simply adding it to a log-domain sample. Like on the DX7
+ * the segments are linear in the log domain, which means that the amplitude rises and
+ * falls exponentially. The envelope starts and ends at `DSP_LOG_SILENCE`.
+ *
+ * @param adsr ADSR envelope generator
+ * @returns Next attenuation
+ */
+static inline dsp_log_t dsp_adsr_tick_log(dsp_adsr_t* adsr) {
+    int32_t value = adsr->state.value_log;
+
+    switch (adsr->state.status) {
+        case DSP_ADSR_ATTACK:
+            adsr->state.value_log += adsr->envelope.attack.increment_log;
+
+            if (adsr->state.value_log <= adsr->envelope.attack.value_log) {
+                adsr->state.status    = DSP_ADSR_DECAY;
+                adsr->state.value_log = adsr->envelope.attack.value_log;
+            }
+
+            break;
+        case DSP_ADSR_DECAY:
+            adsr->state.value_log += adsr->envelope.decay.increment_log;
+
+            if (adsr->state.value_log >= adsr->envelope.decay.value_log) {
+                adsr->state.status    = DSP_ADSR_SUSTAIN;
+                adsr->state.value_log = adsr->envelope.decay.value_log;
+            }
+
+            break;
+        case DSP_ADSR_RELEASE:
+            adsr->state.value_log += adsr->envelope.release.increment_log;
+
+            if (adsr->state.value_log >= adsr->envelope.release.value_log) {
+                adsr->state.status    = DSP_ADSR_STOPPED;
+                adsr->state.value_log = adsr->envelope.release.value_log;
+            }
+
+            break;
+        default:
+            // Suppress compiler error: Enumeration value not handled in switch
+            break;
+    }
+
+    return (dsp_log_t) (value >> 16);
+}
@@ -0,0 +1,246 @@
+/*
+ * Klimper: ESP32 I²S Synthesizer Test / µDSP Library
+ * © 2024 Dennis Schulmeister-Zimolong <dennis@wpvs.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ */
+
+#include "delay.h"
+
+#include <esp_attr.h>                       // IRAM_ATTR, FORCE_INLINE_ATTR
+#include <esp_heap_caps.h>                  // heap_caps_calloc(), heap_caps_free()
+#include <string.h>                         // memcpy()
+#include "wavetable.h"                      // dsp_wavetable_get()
+
+/**
+ * Longest step of the delay per block: Half a block, so that the read window of one
+ * block never exceeds one and a half blocks plus the interpolation guards.
+ */
+#define DSP_DELAY_MAX_STEP_Q16 ((int64_t) DSP_DELAY_BLOCK_FRAMES << 15)
+
+/**
+ * Shortest delay in frames: The read window of a block must lie before the frames
+ * written in the same block.
+ */
+#define DSP_DELAY_MIN_FRAMES (DSP_DELAY_BLOCK_FRAMES + 2)
+
+/**
+ * Largest Q15 value written into the delay lines, that still counts as silence
+ * (about -78 dBFS). The feedback rounds such small values quickly down to zero.
+ */
+#define DSP_DELAY_SILENCE (4)
+
+/**
+ * Allocate a delay line in PSRAM or, if there is none, in internal RAM.
+ */
+static int16_t* dsp_delay_new_line(size_t length, bool* psram) {
+    int16_t* line = heap_caps_calloc(length, sizeof(int16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    *psram = line != NULL;
+
+    if (!line) line = heap_caps_calloc(length, sizeof(int16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    return line;
+}
+
+/**
+ * Create new delay instance.
+ */
+dsp_delay_t* dsp_delay_new(float max_delay) {
+    dsp_delay_t* delay = heap_caps_calloc(1, sizeof(dsp_delay_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!delay) return NULL;
+
+    delay->length = (size_t) (max_delay * CONFIG_AUDIO_SAMPLE_RATE) + DSP_DELAY_MIN_FRAMES + 2;
+    delay->silent_frames = delay->length;
+
+    bool psram_left, psram_right;
+    delay->line[0] = dsp_delay_new_line(delay->length, &psram_left);
+    delay->line[1] = dsp_delay_new_line(delay->length, &psram_right);
+    delay->psram   = psram_left && psram_right;
+
+    dsp_wavetable_t* sin = dsp_wavetable_get(DSP_WAVETABLE_SIN);
+    delay->lfo[0] = dsp_oscil_new(sin);
+    delay->lfo[1] = dsp_oscil_new(sin);
+
+    if (!delay->line[0] || !delay->line[1] || !delay->lfo[0] || !delay->lfo[1]) {
+        dsp_delay_free(delay);
+        return NULL;
+    }
+
+    // Right channel a quarter cycle ahead for a wider stereo image
+    delay->lfo[1]->phase     = 1u << 30;
+    delay->lfo[1]->index_q16 = delay->lfo[1]->length_q16 / 4;
+
+    delay->center_q16 = (int64_t) DSP_DELAY_MIN_FRAMES << 16;
+    return delay;
+}
+
+/**
+ * Free memory of a given delay.
+ */
+void dsp_delay_free(dsp_delay_t* delay) {
+    heap_caps_free(delay->line[0]);
+    heap_caps_free(delay->line[1]);
+    if (delay->lfo[0]) dsp_oscil_free(delay->lfo[0]);
+    if (delay->lfo[1]) dsp_oscil_free(delay->lfo[1]);
+    heap_caps_free(delay);
+}
+
+/**
+ * Convert and clamp the delay values.
+ */
+void dsp_delay_set_values(dsp_delay_t* delay, const dsp_delay_values_t* values) {
+    float min    = DSP_DELAY_MIN_FRAMES;
+    float max    = delay->length - 2;
+    float center = values->delay * CONFIG_AUDIO_SAMPLE_RATE;
+    float depth  = values->depth * CONFIG_AUDIO_SAMPLE_RATE;
+
+    if (center < min) center = min;
+    if (center > max) center = max;
+    if (depth < 0.0f) depth = 0.0f;
+    if (depth > center - min) depth = center - min;
+    if (depth > max - center) depth = max - center;
+
+    // Steepest slope of the modulation is depth * 2π * rate per frame, which must stay
+    // well below one frame per frame, as the delay would otherwise run backwards
+    float rate     = values->rate > 0.0f ? values->rate : 0.0f;
+    float rate_max = depth > 0.0f ? 0.5f * CONFIG_AUDIO_SAMPLE_RATE / (6.2831853f * depth) : rate;
+    if (rate > rate_max) rate = rate_max;
+
+    float feedback = values->feedback;
+    if (feedback < 0.0f)  feedback = 0.0f;
+    if (feedback > 0.95f) feedback = 0.95f;
+
+    delay->center_q16   = (int64_t) (center * 65536.0f);
+    delay->depth_q16    = (int64_t) (depth * 65536.0f);
+    delay->feedback_q15 = (int32_t) (feedback * DSP_Q15_ONE);
+    delay->mix_q15      = dsp_q15_from_float(values->mix);
+
+    dsp_oscil_reinit(delay->lfo[0], rate, false);
+    dsp_oscil_reinit(delay->lfo[1], rate, false);
+
+    if (!delay->running) {
+        delay->position_q16[0] = delay->center_q16;
+        delay->position_q16[1] = delay->center_q16;
+    }
+}
+
+/**
+ * Convert a sample of the active DSP engine to Q15.
+ */
+FORCE_INLINE_ATTR int32_t dsp_delay_to_q15(dsp_sample_t sample) {
+#if CONFIG_DSP_ENGINE_FLOAT
+    return (int32_t) (sample * 32767.0f);
+#else
+    return sample;
+#endif
+}
+
+/**
+ * Convert a Q15 sample to the active DSP engine.
+ */
+FORCE_INLINE_ATTR dsp_sample_t dsp_delay_from_q15(int32_t sample) {
+#if CONFIG_DSP_ENGINE_FLOAT
+    return sample * (1.0f / 32767.0f);
+#else
+    return sample;
+#endif
+}
+
+/**
+ * Process one channel of one staging block. The delay ramps linearly from the current
+ * to the new position, with the first frame already taking one step, like the gain ramps.
+ * Returns the peak magnitude of the frames written into the delay line.
+ */
+static int32_t IRAM_ATTR dsp_delay_process_channel(dsp_delay_t* delay, int channel, dsp_sample_t* buffer, size_t n) {
+    int16_t* line   = delay->line[channel];
+    size_t   length = delay->length;
+
+    // New position from the LFO, limited to the longest step per block
+    dsp_oscil_t* lfo = delay->lfo[channel];
+    if (n > 1) dsp_oscil_skip(lfo, n - 1);
+
+    int64_t from_q16 = delay->position_q16[channel];
+    int64_t to_q16   = delay->center_q16 + (int64_t) (delay->depth_q16 * dsp_oscil_tick(lfo, 0.0f));
+
+    if (to_q16 - from_q16 > DSP_DELAY_MAX_STEP_Q16) to_q16 = from_q16 + DSP_DELAY_MAX_STEP_Q16;
+    if (from_q16 - to_q16 > DSP_DELAY_MAX_STEP_Q16) to_q16 = from_q16 - DSP_DELAY_MAX_STEP_Q16;
+
+    delay->position_q16[channel] = to_q16;
+
+    // Read position of the first frame, and the window from there to the frame after
+    // the last read position, which moves by one frame minus the step per frame
+    int32_t step_q16 = (int32_t) ((to_q16 - from_q16) / (int64_t) n);
+    int64_t read_q16 = ((int64_t) delay->write << 16) - from_q16 - step_q16;
+    int64_t start    = read_q16 >> 16;
+    int32_t rel_q16  = (int32_t) (read_q16 - start * 65536);
+    int32_t inc_q16  = 65536 - step_q16;
+    size_t  window   = (size_t) ((rel_q16 + (int64_t) (n - 1) * inc_q16) >> 16) + 2;
+
+    // Fetch the window in one or two pieces
+    size_t first = (size_t) ((start % (int64_t) length + (int64_t) length) % (int64_t) length);
+    size_t count = length - first < window ? length - first : window;
+
+    int16_t* stage = delay->stage_read;
+    memcpy(stage, line + first, count * sizeof(int16_t));
+    if (count < window) memcpy(stage + count, line, (window - count) * sizeof(int16_t));
+
+    int16_t* written  = delay->stage_write;
+    int32_t  feedback = delay->feedback_q15;
+    int32_t  mix      = delay->mix_q15;
+    int32_t  peak     = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        int32_t index = rel_q16 >> 16;
+        int32_t frac  = (rel_q16 & 0xFFFF) >> 1;
+        int32_t s0    = stage[index];
+        int32_t s1    = stage[index + 1];
+        rel_q16 += inc_q16;
+
+        int32_t delayed = s0 + (((s1 - s0) * frac) >> 15);
+        int32_t input   = dsp_delay_to_q15(buffer[2 * i]);
+        int32_t output  = input + (delayed * feedback) / 32768;    // Toward zero, so that the tail decays to zero
+
+        if (output < -DSP_Q15_ONE) output = -DSP_Q15_ONE;
+        else if (output > DSP_Q15_ONE) output = DSP_Q15_ONE;
+
+        int32_t magnitude = output < 0 ? -output : output;
+        if (magnitude > peak) peak = magnitude;
+
+        written[i]     = (int16_t) output;
+        buffer[2 * i] += dsp_delay_from_q15((delayed * mix) >> 15);
+    }
+
+    // Store the written frames in one or two pieces
+    first = delay->write;
+    count = length - first < n ? length - first : n;
+
+    memcpy(line + first, written, count * sizeof(int16_t));
+    if (count < n) memcpy(line, written + count, (n - count) * sizeof(int16_t));
+
+    return peak;
+}
+
+/**
+ * Process a block of interleaved stereo samples in staging blocks. Counts the frames
+ * since the last one above the silence threshold was written into the delay lines.
+ */
+void IRAM_ATTR dsp_delay_process(dsp_delay_t* delay, dsp_sample_t* buffer, size_t n) {
+    size_t n_frames = n / 2;
+    delay->running  = true;
+
+    for (size_t done = 0; done < n_frames;) {
+        size_t frames = n_frames - done;
+        if (frames > DSP_DELAY_BLOCK_FRAMES) frames = DSP_DELAY_BLOCK_FRAMES;
+
+        int32_t peak_left  = dsp_delay_process_channel(delay, 0, buffer + 2 * done,     frames);
+        int32_t peak_right = dsp_delay_process_channel(delay, 1, buffer + 2 * done + 1, frames);
+
+        if (peak_left > DSP_DELAY_SILENCE || peak_right > DSP_DELAY_SILENCE) delay->silent_frames = 0;
+        else if (delay->silent_frames < delay->length) delay->silent_frames += frames;
+
+        delay->write = (delay->write + frames) % delay->length;
+        done += frames;
+    }
+}
@@ -0,0 +1,111 @@
+/*
+ * Klimper: ESP32 I²S Synthesizer Test / µDSP Library
+ * © 2024 Dennis Schulmeister-Zimolong <dennis@wpvs.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ */
+
+#pragma once
+
+#include <stdbool.h>                        // bool, true, false
+#include <stddef.h>                         // size_t
+#include <stdint.h>                         // int16_t, int32_t, int64_t
+#include "oscil.h"                          // dsp_oscil_t
+#include "sample.h"                         // dsp_sample_t
+
+#define DSP_DELAY_BLOCK_FRAMES (64)         // Frames processed per staging block
+
+/**
+ * Data transfer structure for the delay values. A short delay with some depth
+ * gives a chorus, a long delay without depth and with feedback an echo.
+ */
+typedef struct {
+    float delay;                            // Delay time in seconds (center of the modulation)
+    float depth;                            // Modulation depth in seconds (0 for a fixed delay)
+    float rate;                             // Modulation rate in Hz
+    float feedback;                         // Feedback of the delayed signal [0 … 0.95]
+    float mix;                              // Level of the delayed signal added to the input [0 … 1]
+} dsp_delay_values_t;
+
+/**
+ * Stereo delay line with a modulated read position. The delay lines are usually
+ * too long for the internal RAM and live in the external PSRAM, if there is one.
+ * Since the PSRAM is slow for scattered accesses via the cache, they are never
+ * accessed per sample: For each block of up to `DSP_DELAY_BLOCK_FRAMES` frames the
+ * window read by the modulated position is copied into an internal staging buffer,
+ * and the written frames are collected in another one and copied back in one piece.
+ *
+ * The lines hold 16-bit samples, one line per channel, to halve the PSRAM traffic.
+ * The delay is computed in Q15 for all DSP engines.
+ */
+typedef struct {
+    int16_t*     line[2];                   // Delay line of the left and right channel
+    size_t       length;                    // Length of each delay line in frames
+    size_t       write;                     // Next write position
+    bool         psram;                     // Delay lines in external PSRAM
+    bool         running;                   // Processed at least once (new values glide in)
+    size_t       silent_frames;             // Consecutive silent frames written (up to the length)
+
+    dsp_oscil_t* lfo[2];                    // Modulation of the left and right delay (quarter phase apart)
+    int64_t      position_q16[2];           // Current delay of each channel in frames (16 fractional bits)
+    int64_t      center_q16;                // Center delay in frames (16 fractional bits)
+    int64_t      depth_q16;                 // Modulation depth in frames (16 fractional bits)
+    int32_t      feedback_q15;              // Feedback gain
+    int32_t      mix_q15;                   // Output gain of the delayed signal
+
+    int16_t      stage_read[2 * DSP_DELAY_BLOCK_FRAMES + 4]; // Read window of one channel
+    int16_t      stage_write[DSP_DELAY_BLOCK_FRAMES];        // Written frames of one channel
+} dsp_delay_t;
+
+/**
+ * Create a new stereo delay. The delay lines are allocated in PSRAM if available,
+ * otherwise in internal RAM, and cleared. The delay is silent until its values are
+ * set with `dsp_delay_set_values()`.
+ *
+ * @param max_delay Longest possible delay time in seconds (center plus depth)
+ * @returns Pointer to the new delay or `NULL` if there is not enough memory
+ */
+dsp_delay_t* dsp_delay_new(float max_delay);
+
+/**
+ * Free memory of a given delay.
+ * @param delay Delay instance
+ */
+void dsp_delay_free(dsp_delay_t* delay);
+
+/**
+ * Change the delay values. The delay and depth are clamped so that the read
+ * window always fits the delay line and the staging buffer, and the rate so
+ * that the modulated delay changes slower than the time passes. Once the delay
+ * is running, the current delay moves smoothly to the new values within the
+ * following blocks.
+ *
+ * @param delay Delay instance
+ * @param values New values (can be freed afterwards)
+ */
+void dsp_delay_set_values(dsp_delay_t* delay, const dsp_delay_values_t* values);
+
+/**
+ * Process a block of interleaved stereo samples in place: The delayed signal is
+ * added to the input and the input plus the feedback written into the delay lines.
+ *
+ * @param delay Delay instance
+ * @param buffer [in/out] Interleaved stereo samples of the active DSP engine
+ * @param n Number of samples (two per stereo frame)
+ */
+void dsp_delay_process(dsp_delay_t* delay, dsp_sample_t* buffer, size_t n);
+
+/**
+ * Check whether the delay tail has died away: The delay lines contain nothing above
+ * the silence threshold, so that processing silent input would only output silence.
+ * Then `dsp_delay_process()` can be skipped until there is new input.
+ *
+ * @param delay Delay instance
+ * @returns `true` if the delay lines are silent
+ */
+static inline bool dsp_delay_is_silent(const dsp_delay_t* delay) {
+    return delay->silent_frames >= delay->length;
+}
@@ -0,0 +1,161 @@
+/*
+ * Klimper: ESP32 I²S Synthesizer Test / µDSP Library
+ * © 2024 Dennis Schulmeister-Zimolong <dennis@wpvs.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ */
+
+#include "mix.h"
+
+#include <esp_attr.h>                       // IRAM_ATTR
+#include <string.h>                         // memset()
+#include "utils.h"                          // DSP_UNROLL()
+
+#if CONFIG_DSP_USE_ESP_DSP
+    #include <esp_dsp.h>                    // dsps_add_f32(), dsps_mul_f32(), dsps_mulc_f32()
+#endif
+
+/**
+ * Set all samples to zero. Zero is all bits cleared for float and integers.
+ */
+void IRAM_ATTR dsp_mix_clear(dsp_sample_t* buffer, size_t n) {
+    memset(buffer, 0, n * sizeof(dsp_sample_t));
+}
+
+/**
+ * Add the input samples to the output buffer.
+ */
+void IRAM_ATTR dsp_mix_add(dsp_sample_t* output, const dsp_sample_t* input, size_t n) {
+#if CONFIG_DSP_ENGINE_FLOAT
+    dsp_mix_add_f32(output, 1, input, n);
+#else
+    for (size_t i = 0; i < n; i++) output[i] += input[i];
+#endif
+}
+
+/**
+ * Add with a linearly ramped gain. The integer version ramps the gain in Q8.24, so
+ * that slow ramps don't lose their step size, and multiplies in 64 bits, since the
+ * input samples can exceed Q15 before the gain has been applied.
+ */
+void IRAM_ATTR dsp_mix_add_ramp(dsp_sample_t* output, const dsp_sample_t* input, float gain0, float gain1, size_t n) {
+    size_t n_frames = n / 2;
+    if (!n_frames) return;
+
+#if CONFIG_DSP_ENGINE_FLOAT
+    float step = (gain1 - gain0) / n_frames;
+    float gain = gain0;
+
+    DSP_UNROLL(2)
+    for (size_t i = 0; i < n; i += 2) {
+        gain += step;
+        output[i    ] += input[i    ] * gain;
+        output[i + 1] += input[i + 1] * gain;
+    }
+#else
+    int32_t step = (int32_t) ((gain1 - gain0) * 16777216.0f / n_frames);
+    int32_t gain = (int32_t) (gain0 * 16777216.0f);
+
+    DSP_UNROLL(2)
+    for (size_t i = 0; i < n; i += 2) {
+        gain += step;
+        output[i    ] += (int32_t) (((int64_t) input[i    ] * gain) >> 24);
+        output[i + 1] += (int32_t) (((int64_t) input[i + 1] * gain) >> 24);
+    }
+#endif
+}
+
+/**
+ * Convert to signed 16-bit integers with saturation. Rounding is done by hand,
+ * since `roundf()` is a rather slow library call on the ESP32.
+ */
+void IRAM_ATTR dsp_mix_to_int16(dsp_sample_t* input, int16_t* output, size_t n) {
+#if CONFIG_DSP_ENGINE_FLOAT
+    dsp_mix_mulc_f32(input, 32767.0f, n);
+
+    for (size_t i = 0; i < n; i++) {
+        float sample = input[i];
+
+        if (sample < -32767.0f) sample = -32767.0f;
+        else if (sample > 32767.0f) sample = 32767.0f;
+
+        output[i] = (int16_t) (sample >= 0.0f ? sample + 0.5f : sample - 0.5f);
+    }
+#else
+    for (size_t i = 0; i < n; i++) {
+        int32_t sample = input[i];
+
+        if (sample < -DSP_Q15_ONE) sample = -DSP_Q15_ONE;
+        else if (sample > DSP_Q15_ONE) sample = DSP_Q15_ONE;
+
+        output[i] = (int16_t) sample;
+    }
+#endif
+}
+
+/**
+ * Convert to left-justified signed 32-bit integers in place. The full scale is the same
+ * as for 16 bits, just shifted. Float buffers are accessed through a union, so that the
+ * compiler knows that float and integer values share the same memory.
+ */
+void IRAM_ATTR dsp_mix_to_int32(dsp_sample_t* buffer, size_t n) {
+#if CONFIG_DSP_ENGINE_FLOAT
+    union { float f; int32_t i; }* words = (void*) buffer;
+
+    dsp_mix_mulc_f32(buffer, 32767.0f * 65536.0f, n);
+
+    for (size_t i = 0; i < n; i++) {
+        float sample = words[i].f;
+
+        if (sample < -32767.0f * 65536.0f) sample = -32767.0f * 65536.0f;
+        else if (sample > 32767.0f * 65536.0f) sample = 32767.0f * 65536.0f;
+
+        words[i].i = (int32_t) sample;
+    }
+#else
+    for (size_t i = 0; i < n; i++) {
+        int32_t sample = buffer[i];
+
+        if (sample < -DSP_Q15_ONE) sample = -DSP_Q15_ONE;
+        else if (sample > DSP_Q15_ONE) sample = DSP_Q15_ONE;
+
+        buffer[i] = sample * 65536;
+    }
+#endif
+}
+
+/**
+ * Multiply two float buffers sample by sample.
+ */
+void IRAM_ATTR dsp_mix_mul_f32(float* output, const float* input, size_t n) {
+#if CONFIG_DSP_USE_ESP_DSP
+    dsps_mul_f32(output, input, output, n, 1, 1, 1);
+#else
+    for (size_t i = 0; i < n; i++) output[i] *= input[i];
+#endif
+}
+
+/**
+ * Multiply a float buffer with a constant.
+ */
+void IRAM_ATTR dsp_mix_mulc_f32(float* buffer, float c, size_t n) {
+#if CONFIG_DSP_USE_ESP_DSP
+    dsps_mulc_f32(buffer, buffer, n, c, 1, 1);
+#else
+    for (size_t i = 0; i < n; i++) buffer[i] *= c;
+#endif
+}
+
+/**
+ * Add a float buffer to every `step`-th output sample.
+ */
+void IRAM_ATTR dsp_mix_add_f32(float* output, int step, const float* input, size_t n) {
+#if CONFIG_DSP_USE_ESP_DSP
+    dsps_add_f32(output, input, output, n, step, 1, step);
+#else
+    for (size_t i = 0; i < n; i++) output[i * step] += input[i];
+#endif
+}
@@ -0,0 +1,103 @@
+/*
+ * Klimper: ESP32 I²S Synthesizer Test / µDSP Library
+ * © 2024 Dennis Schulmeister-Zimolong <dennis@wpvs.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ */
+
+#pragma once
+
+#include <stddef.h>                         // size_t
+#include <stdint.h>                         // int16_t
+#include "sample.h"                         // dsp_sample_t
+
+/**
+ * Vector kernels to clear, mix, scale and convert whole sample buffers. With
+ * `CONFIG_DSP_USE_ESP_DSP` the floating-point versions use the optimized assembler
+ * functions of Espressif's ESP-DSP library, otherwise simple scalar loops.
+ * The `_f32` functions are meant for the float scratch buffers of the voice kernel.
+ */
+
+/**
+ * Set all samples of a buffer to zero.
+ *
+ * @param buffer Sample buffer
+ * @param n Number of samples
+ */
+void dsp_mix_clear(dsp_sample_t* buffer, size_t n);
+
+/**
+ * Add the input samples to the output buffer.
+ *
+ * @param output [in/out] Buffer to mix into
+ * @param input Samples to be added
+ * @param n Number of samples
+ */
+void dsp_mix_add(dsp_sample_t* output, const dsp_sample_t* input, size_t n);
+
+/**
+ * Add an interleaved stereo buffer to the output buffer with a gain ramped linearly
+ * from `gain0` to `gain1`, so that gain changes don't cause zipper noise. Both samples
+ * of a frame get the same gain. The first frame already takes one step, so that the
+ * last frame gets exactly `gain1` and the next ramp can start where this one ended.
+ *
+ * @param output [in/out] Interleaved stereo buffer to mix into
+ * @param input Interleaved stereo samples to add
+ * @param gain0 Gain before the first frame
+ * @param gain1 Gain of the last frame
+ * @param n Number of samples (two per stereo frame)
+ */
+void dsp_mix_add_ramp(dsp_sample_t* output, const dsp_sample_t* input, float gain0, float gain1, size_t n);
+
+/**
+ * Convert a buffer to signed 16-bit integers with saturation, as needed by the DAC.
+ * Floating-point samples are scaled in place before the conversion, so the content
+ * of the input buffer is undefined afterwards.
+ *
+ * @param input Sample buffer (will be overwritten)
+ * @param output [out] 16-bit output samples
+ * @param n Number of samples
+ */
+void dsp_mix_to_int16(dsp_sample_t* input, int16_t* output, size_t n);
+
+/**
+ * Convert a buffer in place to left-justified signed 32-bit integers with saturation,
+ * as needed for 32-bit I²S slots. Since all sample types have 32 bits, the converted
+ * samples simply replace the original samples.
+ *
+ * @param buffer [in/out] Sample buffer, contains `int32_t` values afterwards
+ * @param n Number of samples
+ */
+void dsp_mix_to_int32(dsp_sample_t* buffer, size_t n);
+
+/**
+ * Multiply two float buffers sample by sample: `output[i] *= input[i]`.
+ *
+ * @param output [in/out] First factor and result
+ * @param input Second factor
+ * @param n Number of samples
+ */
+void dsp_mix_mul_f32(float* output, const float* input, size_t n);
+
+/**
+ * Multiply a float buffer with a constant: `buffer[i] *= c`.
+ *
+ * @param buffer [in/out] Sample buffer
+ * @param c Constant factor
+ * @param n Number of samples
+ */
+void dsp_mix_mulc_f32(float* buffer, float c, size_t n);
+
+/**
+ * Add a float buffer to every `step`-th sample of the output buffer, e.g. to mix a
+ * mono block into one channel of an interleaved stereo buffer.
+ *
+ * @param output [in/out] Buffer to mix into
+ * @param step Distance between two output samples
+ * @param input Samples to be added
+ * @param n Number of input samples
+ */
+void dsp_mix_add_f32(float* output, int step, const float* input, size_t n);
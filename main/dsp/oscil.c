@@ -10,24 +10,71 @@
 
 #include "oscil.h"
 
-#include <stdlib.h>                         // calloc(), malloc(), free()
+#include <assert.h>                         // assert()
+#include <esp_attr.h>                       // IRAM_ATTR, FORCE_INLINE_ATTR
+#include <stdlib.h>                         // malloc(), free()
+#include <string.h>                         // memset()
+#include "utils.h"                          // DSP_UNROLL()
 
 /**
  * Create new oscillator instance.
  */
 dsp_oscil_t* dsp_oscil_new(dsp_wavetable_t* wavetable) {
-    dsp_oscil_t* oscil = calloc(1, sizeof(dsp_oscil_t));
-    oscil->wavetable = wavetable;
+    dsp_oscil_t* oscil = malloc(sizeof(dsp_oscil_t));
+    dsp_oscil_init(oscil, wavetable);
     return oscil;
 }
 
+/**
+ * Initialize oscillator in place.
+ */
+void dsp_oscil_init(dsp_oscil_t* oscil, dsp_wavetable_t* wavetable) {
+    // Power of two for the phase accumulator, limited for the Q16.16 index
+    assert(wavetable->length <= DSP_WAVETABLE_MAX_LENGTH);
+    assert(wavetable->length && !(wavetable->length & (wavetable->length - 1)));
+
+    memset(oscil, 0, sizeof(dsp_oscil_t));
+
+    oscil->wavetable   = wavetable;
+    oscil->phase_shift = 32 - __builtin_ctz(wavetable->length);
+    oscil->phase_scale = 1.0f / (float) (1u << oscil->phase_shift);
+    oscil->length_q16  = (int32_t) (wavetable->length << 16);
+    oscil->fm_scale_q8 = (int32_t) (wavetable->length * 0.01f * 256.0f + 0.5f);
+}
+
+/**
+ * Create new oscillator instance for a band-limited wavetable. All levels have the
+ * same length, so the phase scaling of level 0 fits all of them.
+ */
+dsp_oscil_t* dsp_oscil_new_mipmap(dsp_wavetable_mipmap_t* mipmap) {
+    dsp_oscil_t* oscil = dsp_oscil_new(mipmap->levels[0]);
+    oscil->mipmap = mipmap;
+    return oscil;
+}
+
+/**
+ * Calculate pitch values for the given frequency.
+ */
+void dsp_oscil_get_pitch(dsp_oscil_t* oscil, float frequency, dsp_oscil_pitch_t* pitch) {
+    pitch->frequency = frequency;
+    pitch->wavetable = oscil->mipmap ? dsp_wavetable_mipmap_select(oscil->mipmap, frequency) : oscil->wavetable;
+
+    pitch->phase_increment = (uint32_t) (frequency * (4294967296.0f / CONFIG_AUDIO_SAMPLE_RATE));
+    pitch->increment_q16   = (int32_t) (frequency * pitch->wavetable->length / CONFIG_AUDIO_SAMPLE_RATE * 65536.0f);
+}
+
 /**
  * Reinitialize oscillator with the given frequency.
  */
 void dsp_oscil_reinit(dsp_oscil_t* oscil, float frequency, bool reset_index) {
-    oscil->frequency = frequency;
-    oscil->increment = frequency * oscil->wavetable->length / CONFIG_AUDIO_SAMPLE_RATE;
-    if (reset_index) oscil->index = 0;
+    dsp_oscil_pitch_t pitch;
+    dsp_oscil_get_pitch(oscil, frequency, &pitch);
+    dsp_oscil_set_pitch(oscil, &pitch);
+
+    if (reset_index) {
+        oscil->phase     = 0;
+        oscil->index_q16 = 0;
+    }
 }
 
 /**
@@ -36,3 +83,132 @@ void dsp_oscil_reinit(dsp_oscil_t* oscil, float frequency, bool reset_index) {
 void dsp_oscil_free(dsp_oscil_t* oscil) {
     free(oscil);
 }
+
+/**
+ * Advance the oscillator without rendering. The 32-bit phase simply wraps around,
+ * the Q16 index needs 64 bits to be exact for long pauses. For the default wavetable
+ * length the wrap is a mask, otherwise the expensive 64-bit modulo is only needed
+ * when the index actually wraps, which is rare for the LFOs that are advanced once
+ * per block.
+ */
+void IRAM_ATTR dsp_oscil_skip(dsp_oscil_t* oscil, uint32_t n) {
+    oscil->phase += oscil->phase_increment * n;
+
+    uint64_t index_q16 = (uint64_t) oscil->index_q16 + (uint64_t) oscil->increment_q16 * n;
+
+    if (oscil->length_q16 == DSP_OSCIL_LENGTH_Q16) {
+        index_q16 &= (uint64_t) DSP_OSCIL_LENGTH_Q16 - 1;
+    } else if (index_q16 >= (uint64_t) oscil->length_q16) {
+        index_q16 %= (uint64_t) oscil->length_q16;
+    }
+
+    oscil->index_q16 = (int32_t) index_q16;
+}
+
+/**
+ * Block loop of `dsp_oscil_process()`. It keeps the phase in a local variable and reads
+ * the wavetable through a local pointer, so that the compiler doesn't need to reload
+ * them after each store to the output. The function is always inlined, so that each
+ * caller gets its own copy, in which a constant phase shift is folded into the shifts
+ * and masks.
+ */
+FORCE_INLINE_ATTR void dsp_oscil_process_loop(dsp_oscil_t* oscil, const float* modulator, float* output, size_t n, uint32_t shift, float scale) {
+    const float* samples   = oscil->wavetable->samples;
+    uint32_t     phase     = oscil->phase;
+    uint32_t     increment = oscil->phase_increment;
+    uint32_t     mask      = (1u << shift) - 1;
+
+    DSP_UNROLL(2)
+    for (size_t i = 0; i < n; i++) {
+        uint32_t index = phase >> shift;
+        float    value = samples[index];
+
+        output[i] = value + (samples[index + 1] - value) * ((float) (phase & mask) * scale);
+        phase    += increment + (modulator ? (uint32_t) (int32_t) modulator[i] : 0);
+    }
+
+    oscil->phase = phase;
+}
+
+/**
+ * Block loop of `dsp_oscil_process_q15()`. Like above, with a local copy of the wavetable
+ * descriptor for the sample pointer. The index wraps at the given length, which for
+ * power-of-two lengths is a simple mask.
+ */
+FORCE_INLINE_ATTR void dsp_oscil_process_q15_loop(dsp_oscil_t* oscil, const int32_t* modulator, q15_t* output, size_t n, int32_t length_q16) {
+    dsp_wavetable_t wavetable = *oscil->wavetable;
+    int32_t         index_q16 = oscil->index_q16;
+    int32_t         increment = oscil->increment_q16;
+    int32_t         fm_scale  = oscil->fm_scale_q8;
+    bool            pow2      = !(length_q16 & (length_q16 - 1));
+
+    DSP_UNROLL(2)
+    for (size_t i = 0; i < n; i++) {
+        output[i]  = dsp_wavetable_read2_q15(&wavetable, (uint32_t) index_q16);
+        index_q16 += increment + (modulator ? (modulator[i] * fm_scale) >> 7 : 0);
+
+        if (pow2) {
+            index_q16 &= length_q16 - 1;
+        } else {
+            while (index_q16 >= length_q16) index_q16 -= length_q16;
+            while (index_q16 < 0) index_q16 += length_q16;
+        }
+    }
+
+    oscil->index_q16 = index_q16;
+}
+
+/**
+ * Block loop of `dsp_oscil_process_log()`. The log-sine table always has the same length,
+ * so only the modulator needs a specialized copy.
+ */
+FORCE_INLINE_ATTR void dsp_oscil_process_log_loop(dsp_oscil_t* oscil, const int32_t* modulator, dsp_log_t* output, size_t n) {
+    dsp_wavetable_t wavetable = *oscil->wavetable;
+    uint32_t        phase     = oscil->phase;
+    uint32_t        increment = oscil->phase_increment;
+
+    DSP_UNROLL(2)
+    for (size_t i = 0; i < n; i++) {
+        output[i] = dsp_wavetable_read_logsin(&wavetable, phase);
+        phase    += increment + (modulator ? (uint32_t) modulator[i] << DSP_OSCIL_LOG_FM_SHIFT : 0);
+    }
+
+    oscil->phase = phase;
+}
+
+/**
+ * Render a block of samples. Separate loops are instantiated with and without modulator
+ * and, for the default wavetable length, with constant phase shift. Other lengths use
+ * the generic loop with the shift of the oscillator.
+ */
+void IRAM_ATTR dsp_oscil_process(dsp_oscil_t* oscil, const float* modulator, float* output, size_t n) {
+    if (oscil->phase_shift == DSP_OSCIL_PHASE_SHIFT) {
+        if (modulator) dsp_oscil_process_loop(oscil, modulator, output, n, DSP_OSCIL_PHASE_SHIFT, DSP_OSCIL_PHASE_SCALE);
+        else dsp_oscil_process_loop(oscil, NULL, output, n, DSP_OSCIL_PHASE_SHIFT, DSP_OSCIL_PHASE_SCALE);
+    } else {
+        if (modulator) dsp_oscil_process_loop(oscil, modulator, output, n, oscil->phase_shift, oscil->phase_scale);
+        else dsp_oscil_process_loop(oscil, NULL, output, n, oscil->phase_shift, oscil->phase_scale);
+    }
+}
+
+/**
+ * Fixed-point version of `dsp_oscil_process()`. For the default wavetable length
+ * the index wraps with a constant mask instead of the two compare loops.
+ */
+void IRAM_ATTR dsp_oscil_process_q15(dsp_oscil_t* oscil, const int32_t* modulator, q15_t* output, size_t n) {
+    if (oscil->length_q16 == DSP_OSCIL_LENGTH_Q16) {
+        if (modulator) dsp_oscil_process_q15_loop(oscil, modulator, output, n, DSP_OSCIL_LENGTH_Q16);
+        else dsp_oscil_process_q15_loop(oscil, NULL, output, n, DSP_OSCIL_LENGTH_Q16);
+    } else {
+        if (modulator) dsp_oscil_process_q15_loop(oscil, modulator, output, n, oscil->length_q16);
+        else dsp_oscil_process_q15_loop(oscil, NULL, output, n, oscil->length_q16);
+    }
+}
+
+/**
+ * Log-domain version of `dsp_oscil_process()`.
+ */
+void IRAM_ATTR dsp_oscil_process_log(dsp_oscil_t* oscil, const int32_t* modulator, dsp_log_t* output, size_t n) {
+    if (modulator) dsp_oscil_process_log_loop(oscil, modulator, output, n);
+    else dsp_oscil_process_log_loop(oscil, NULL, output, n);
+}
@@ -11,27 +11,106 @@
 #pragma once
 
 #include <stdbool.h>                        // bool, true, false
+#include <stdint.h>                         // int32_t
+#include "sample.h"                         // q15_t
 #include "wavetable.h"                      // dsp_wavetable_t
 
+/**
+ * Scaling of the modulator input of `dsp_oscil_tick_log()`: The linear Q15 modulator is
+ * shifted left by this amount to get the phase deviation. To get the same modulation depth
+ * as the other tick functions, the FM index must be multiplied with `DSP_OSCIL_LOG_FM_SCALE`
+ * before it is converted to the log domain. Since that is a gain of at most 1.0, the FM
+ * index of the log engine is limited to `DSP_OSCIL_LOG_FM_INDEX_MAX`. A full-scale modulator
+ * then deviates the phase by half a cycle, where the other engines reach their limit, too.
+ */
+#define DSP_OSCIL_LOG_FM_SHIFT     (16)
+#define DSP_OSCIL_LOG_FM_SCALE     (0.02f)  // 0.01 / (2^15 * 2^16 / 2^32)
+#define DSP_OSCIL_LOG_FM_INDEX_MAX (50.0f)  // 1.0 / DSP_OSCIL_LOG_FM_SCALE
+
+/**
+ * Scaling of the modulator input of `dsp_oscil_tick()`: The modulator is expected in phase
+ * units, where 2^32 is one full cycle. An unscaled modulator sample of 1.0 deviates the
+ * phase by 1/100 cycle, like the other tick functions. Multiply the FM index with this
+ * value, so that no extra multiplication per sample is needed. The modulator is converted
+ * to the phase through `int32_t`, so it must stay below half a cycle, i.e. the summed FM
+ * index below `DSP_OSCIL_FM_INDEX_MAX`.
+ */
+#define DSP_OSCIL_FM_SCALE     (42949672.96f)   // 0.01 * 2^32
+#define DSP_OSCIL_FM_INDEX_MAX (49.9f)          // Just below 2^31 / DSP_OSCIL_FM_SCALE
+
+/**
+ * Phase scaling for wavetables of the default length `CONFIG_DSP_WAVETABLE_LENGTH`,
+ * see `dsp_oscil_t`. The block functions use specialized loops with these constants
+ * for such tables and generic loops with the values of the oscillator otherwise.
+ */
+#define DSP_OSCIL_PHASE_SHIFT (32 - __builtin_ctz(CONFIG_DSP_WAVETABLE_LENGTH))
+#define DSP_OSCIL_PHASE_SCALE (1.0f / (float) (1u << DSP_OSCIL_PHASE_SHIFT))
+#define DSP_OSCIL_LENGTH_Q16  ((int32_t) CONFIG_DSP_WAVETABLE_LENGTH << 16)
+
 /**
  * Simple wavetable oscillator with linear interpolation. Note that this requires
- * a wavetable with at least one guard point.
+ * a wavetable with at least one guard point and a power-of-two length. The floating
+ * point and log-domain variants share a 32-bit phase accumulator, whose upper bits
+ * are the table index and whose lower bits are the interpolation fraction, so that
+ * the wraparound comes for free. The fixed-point variant uses its own index, so only
+ * one of the tick functions should be used per oscillator.
  */
 typedef struct {
     dsp_wavetable_t* wavetable;             // Wavetable (not freed)
     float            frequency;             // Frequency in Hz
-    float            increment;             // Index increment
-    float            index;                 // Current index
+
+    dsp_wavetable_mipmap_t* mipmap;         // Band-limited wavetable (optional, not freed)
+
+    uint32_t         phase_increment;       // Phase increment (full 32 bits per cycle)
+    uint32_t         phase;                 // Current phase
+    uint32_t         phase_shift;           // Right shift from phase to table index (32 - log2(length))
+    float            phase_scale;           // Factor from the lower phase bits to the interpolation fraction
+
+    int32_t          increment_q16;         // Fixed point: Index increment (Q16.16)
+    int32_t          index_q16;             // Fixed point: Current index (Q16.16)
+    int32_t          length_q16;            // Fixed point: Wavetable length (Q16.16)
+    int32_t          fm_scale_q8;           // Fixed point: Modulator scaling (Q8)
 } dsp_oscil_t;
 
+/**
+ * Pre-calculated pitch of an oscillator, so that notes can be played from a table
+ * without any floating-point division or wavetable search. See `dsp_oscil_get_pitch()`.
+ */
+typedef struct {
+    float            frequency;             // Frequency in Hz
+    dsp_wavetable_t* wavetable;             // Wavetable or selected mipmap level
+    uint32_t         phase_increment;       // Phase increment (full 32 bits per cycle)
+    int32_t          increment_q16;         // Fixed point: Index increment (Q16.16)
+} dsp_oscil_pitch_t;
+
 /**
  * Create a new oscillator instance and initialize it with zero values.
  *
- * @param wavetable Wavetable (must have one guard point)
+ * @param wavetable Wavetable (must have one guard point and a power-of-two length)
  * @returns Pointer to the new oscillator
  */
 dsp_oscil_t* dsp_oscil_new(dsp_wavetable_t* wavetable);
 
+/**
+ * Initialize an oscillator in memory allocated by the caller, e.g. in an array of
+ * oscillators. Same as `dsp_oscil_new()` without the allocation. Such an oscillator
+ * must not be freed with `dsp_oscil_free()`.
+ *
+ * @param oscil Oscillator memory
+ * @param wavetable Wavetable (must have one guard point and a power-of-two length)
+ */
+void dsp_oscil_init(dsp_oscil_t* oscil, dsp_wavetable_t* wavetable);
+
+/**
+ * Create a new oscillator instance for a band-limited wavetable. The wavetable level is
+ * selected by `dsp_oscil_reinit()` from the frequency, so that the oscillator doesn't
+ * alias. Except for that the oscillator is used like any other.
+ *
+ * @param mipmap Band-limited wavetable
+ * @returns Pointer to the new oscillator
+ */
+dsp_oscil_t* dsp_oscil_new_mipmap(dsp_wavetable_mipmap_t* mipmap);
+
 /**
  * Reinitialize oscillator with the given frequency. Optionally the index can be
  * skipped in order to realize frequency sweeps and pitch bends.
@@ -42,6 +121,17 @@ dsp_oscil_t* dsp_oscil_new(dsp_wavetable_t* wavetable);
  */
 void dsp_oscil_reinit(dsp_oscil_t* oscil, float frequency, bool reset_index);
 
+/**
+ * Calculate the pitch values for the given frequency without changing the oscillator.
+ * The result can be applied to this and any other oscillator with the same wavetable
+ * or mipmap with `dsp_oscil_set_pitch()`.
+ *
+ * @param oscil Oscillator instance
+ * @param frequency Frequency in Hz
+ * @param pitch [out] Pitch values
+ */
+void dsp_oscil_get_pitch(dsp_oscil_t* oscil, float frequency, dsp_oscil_pitch_t* pitch);
+
 /**
  * Free memory of a given oscillator.
  * @param oscil Oscillator instance
@@ -49,14 +139,76 @@ void dsp_oscil_reinit(dsp_oscil_t* oscil, float frequency, bool reset_index);
 void dsp_oscil_free(dsp_oscil_t* oscil);
 
 /**
- * Calculate next sample. Algorithm from "The Audio Programming Book", p302ff.
+ * Advance the oscillator by the given number of samples without rendering them.
+ * The phase is calculated directly from the increment, so that free-running
+ * oscillators (e.g. LFOs) can be paused and later resumed at the same phase as
+ * if they had been running all the time. The index of all tick functions is
+ * advanced.
+ *
+ * @param oscil Oscillator instance
+ * @param n Number of samples to skip
+ */
+void dsp_oscil_skip(dsp_oscil_t* oscil, uint32_t n);
+
+/**
+ * Change the frequency of the oscillator to pre-calculated pitch values. This is the
+ * same as `dsp_oscil_reinit()` without resetting the index, but needs only a few stores.
  *
  * @param oscil Oscillator instance
- * @param modulator Sample output from modulator oscillator (use 0.0f for no FM)
+ * @param pitch Pitch values from `dsp_oscil_get_pitch()`
+ */
+static inline void dsp_oscil_set_pitch(dsp_oscil_t* oscil, const dsp_oscil_pitch_t* pitch) {
+    oscil->frequency       = pitch->frequency;
+    oscil->wavetable       = pitch->wavetable;
+    oscil->phase_increment = pitch->phase_increment;
+    oscil->increment_q16   = pitch->increment_q16;
+}
+
+/**
+ * Render a block of samples. This is the same as calling `dsp_oscil_tick()` for each
+ * sample, but keeps the oscillator state in registers for the whole block.
+ *
+ * @param oscil Oscillator instance
+ * @param modulator Modulator samples (`NULL` for no FM)
+ * @param output [out] Output samples
+ * @param n Number of samples
+ */
+void dsp_oscil_process(dsp_oscil_t* oscil, const float* modulator, float* output, size_t n);
+
+/**
+ * Fixed-point version of `dsp_oscil_process()`.
+ *
+ * @param oscil Oscillator instance
+ * @param modulator Q15 modulator samples (`NULL` for no FM)
+ * @param output [out] Q15 output samples
+ * @param n Number of samples
+ */
+void dsp_oscil_process_q15(dsp_oscil_t* oscil, const int32_t* modulator, q15_t* output, size_t n);
+
+/**
+ * Log-domain version of `dsp_oscil_process()`.
+ *
+ * @param oscil Oscillator instance
+ * @param modulator Linear Q15 modulator samples (`NULL` for no FM)
+ * @param output [out] Output samples as signed attenuation
+ * @param n Number of samples
+ */
+void dsp_oscil_process_log(dsp_oscil_t* oscil, const int32_t* modulator, dsp_log_t* output, size_t n);
+
+/**
+ * Calculate next sample. Algorithm from "The Audio Programming Book", p302ff, but with
+ * an integer phase accumulator: The table index and the interpolation fraction are
+ * simply the upper and lower bits of the phase.
+ *
+ * @param oscil Oscillator instance
+ * @param modulator Modulator in phase units, see `DSP_OSCIL_FM_SCALE` (use 0.0f for no FM)
  * @returns Next sample
  */
 static inline float dsp_oscil_tick(dsp_oscil_t* oscil, float modulator) {
-    float sample = dsp_wavetable_read2(oscil->wavetable, oscil->index);
+    uint32_t index    = oscil->phase >> oscil->phase_shift;
+    float    fraction = (float) (oscil->phase & ((1u << oscil->phase_shift) - 1)) * oscil->phase_scale;
+    float    value    = oscil->wavetable->samples[index];
+    float    sample   = value + (oscil->wavetable->samples[index + 1] - value) * fraction;
 
     // Funny fact: That is quite similar to how the Yamaha DX7 implements FM.
     // It simply adds the phase accumulator with the modulator signal, which
@@ -69,10 +221,44 @@ static inline float dsp_oscil_tick(dsp_oscil_t* oscil, float modulator) {
     // is modulated. This in turn is the same is frequency modulation with the
     // derivate of the modulator function, which for a sinusoid is another
     // (90 degree phase shifted) sinusoid.
-    oscil->index += oscil->increment + (modulator * oscil->wavetable->length * 0.01f);
+    oscil->phase += oscil->phase_increment + (uint32_t) (int32_t) modulator;
+    return sample;
+}
+
+/**
+ * Fixed-point version of `dsp_oscil_tick()`: Calculate next sample. The modulator is
+ * a Q15 value in a 32-bit integer, so that it may exceed the range [-1 … 1] for FM
+ * indices larger than one.
+ *
+ * @param oscil Oscillator instance
+ * @param modulator Q15 sample output from modulator oscillator (use 0 for no FM)
+ * @returns Next Q15 sample
+ */
+static inline q15_t dsp_oscil_tick_q15(dsp_oscil_t* oscil, int32_t modulator) {
+    q15_t sample = dsp_wavetable_read2_q15(oscil->wavetable, (uint32_t) oscil->index_q16);
+
+    // Same as above: Q15 modulator * Q8 scale = Q23, shifted to the Q16 index
+    oscil->index_q16 += oscil->increment_q16 + ((modulator * oscil->fm_scale_q8) >> 7);
+
+    while (oscil->index_q16 >= oscil->length_q16) oscil->index_q16 -= oscil->length_q16;
+    while (oscil->index_q16 < 0) oscil->index_q16 += oscil->length_q16;
 
-    while (oscil->index >= oscil->wavetable->length) oscil->index -= oscil->wavetable->length;
-    while (oscil->index < 0) oscil->index += oscil->wavetable->length;
+    return sample;
+}
 
+/**
+ * Log-domain version of `dsp_oscil_tick()`: Calculate next sample with a quarter-wave
+ * log-sine table (`DSP_WAVETABLE_LOGSIN`), which must have been given as wavetable.
+ * There is no interpolation.
+ * The modulator is a linear Q15 value as returned by `dsp_wavetable_read_exp2()`,
+ * so that no multiplication is needed at all.
+ *
+ * @param oscil Oscillator instance
+ * @param modulator Linear Q15 sample output from modulator oscillator (use 0 for no FM)
+ * @returns Next sample as signed attenuation
+ */
+static inline dsp_log_t dsp_oscil_tick_log(dsp_oscil_t* oscil, int32_t modulator) {
+    dsp_log_t sample = dsp_wavetable_read_logsin(oscil->wavetable, oscil->phase);
+    oscil->phase += oscil->phase_increment + ((uint32_t) modulator << DSP_OSCIL_LOG_FM_SHIFT);
     return sample;
 }
@@ -10,9 +10,14 @@
 
 #include "pan.h"
 
+#include <esp_attr.h>                       // IRAM_ATTR
+#include "utils.h"                          // DSP_UNROLL()
+
 bool             dsp_pan_initialized = false;
 dsp_wavetable_t* dsp_pan_wt_cos      = NULL;
 dsp_wavetable_t* dsp_pan_wt_sin      = NULL;
+dsp_wavetable_t* dsp_pan_wt_logsin   = NULL;
+dsp_wavetable_t* dsp_pan_wt_exp2     = NULL;
 
 /**
  * Static initialization of the wave tables and calculated constants.
@@ -23,4 +28,74 @@ void dsp_pan_init() {
 
     dsp_pan_wt_cos = dsp_wavetable_get(DSP_WAVETABLE_COS);
     dsp_pan_wt_sin = dsp_wavetable_get(DSP_WAVETABLE_SIN);
+
+#if CONFIG_DSP_ENGINE_LOG
+    dsp_pan_wt_logsin = dsp_wavetable_get(DSP_WAVETABLE_LOGSIN);
+    dsp_pan_wt_exp2   = dsp_wavetable_get(DSP_WAVETABLE_EXP2);
+#endif
+}
+
+/**
+ * Pan a block of mono samples with linearly ramped gains.
+ */
+void IRAM_ATTR dsp_pan_mix_ramp(const float* input, float left0, float right0, float left1, float right1, float* output, size_t n) {
+    if (!n) return;
+
+    float step_left  = (left1  - left0)  / n;
+    float step_right = (right1 - right0) / n;
+    float left       = left0;
+    float right      = right0;
+
+    DSP_UNROLL(2)
+    for (size_t i = 0; i < n; i++) {
+        left  += step_left;
+        right += step_right;
+
+        output[2 * i    ] += input[i] * left;
+        output[2 * i + 1] += input[i] * right;
+    }
+}
+
+/**
+ * Fixed-point version of `dsp_pan_mix_ramp()`. The gains are ramped in Q15.16, so
+ * that the step size does not lose the fraction for slow pan movements.
+ */
+void IRAM_ATTR dsp_pan_mix_ramp_q15(const q15_t* input, q15_t left0, q15_t right0, q15_t left1, q15_t right1, int32_t* output, size_t n) {
+    if (!n) return;
+
+    int32_t step_left  = ((int32_t) left1  - left0)  * 65536 / (int32_t) n;
+    int32_t step_right = ((int32_t) right1 - right0) * 65536 / (int32_t) n;
+    int32_t left       = (int32_t) left0  * 65536;
+    int32_t right      = (int32_t) right0 * 65536;
+
+    DSP_UNROLL(2)
+    for (size_t i = 0; i < n; i++) {
+        left  += step_left;
+        right += step_right;
+
+        output[2 * i    ] += dsp_q15_mul(input[i], (q15_t) (left  >> 16));
+        output[2 * i + 1] += dsp_q15_mul(input[i], (q15_t) (right >> 16));
+    }
+}
+
+/**
+ * Log-domain version of `dsp_pan_mix_ramp()`. The attenuations are ramped with
+ * eight fractional bits.
+ */
+void IRAM_ATTR dsp_pan_mix_ramp_log(const dsp_log_t* input, dsp_log_t left0, dsp_log_t right0, dsp_log_t left1, dsp_log_t right1, int32_t* output, size_t n) {
+    if (!n) return;
+
+    int32_t step_left  = ((int32_t) left1  - (int32_t) left0)  * 256 / (int32_t) n;
+    int32_t step_right = ((int32_t) right1 - (int32_t) right0) * 256 / (int32_t) n;
+    int32_t left       = (int32_t) left0  * 256;
+    int32_t right      = (int32_t) right0 * 256;
+
+    DSP_UNROLL(2)
+    for (size_t i = 0; i < n; i++) {
+        left  += step_left;
+        right += step_right;
+
+        output[2 * i    ] += dsp_wavetable_read_exp2(dsp_pan_wt_exp2, input[i] + (dsp_log_t) (left  >> 8));
+        output[2 * i + 1] += dsp_wavetable_read_exp2(dsp_pan_wt_exp2, input[i] + (dsp_log_t) (right >> 8));
+    }
 }
@@ -11,11 +11,16 @@
 #pragma once
 
 #include <stdbool.h>                        // bool, true, false
+#include <stddef.h>                         // size_t
+#include <stdint.h>                         // uint32_t
+#include "sample.h"                         // q15_t
 #include "wavetable.h"                      // wavetable_t
 
 extern bool             dsp_pan_initialized;
 extern dsp_wavetable_t* dsp_pan_wt_cos;
 extern dsp_wavetable_t* dsp_pan_wt_sin;
+extern dsp_wavetable_t* dsp_pan_wt_logsin;
+extern dsp_wavetable_t* dsp_pan_wt_exp2;
 
 /**
  * Static initialization of the wave tables and calculated constants for
@@ -24,6 +29,51 @@ extern dsp_wavetable_t* dsp_pan_wt_sin;
  */
 void dsp_pan_init();
 
+/**
+ * Pan a block of mono samples with gains ramped linearly from `left0`/`right0` to
+ * `left1`/`right1` and add them to a two-channel left/right interleaved output buffer.
+ * This allows to evaluate the pan law only once per block at control rate, usually
+ * with the gains from `dsp_pan_gains()`. The first sample already takes one step,
+ * so that the last sample gets exactly the end gains and the next block can start
+ * where this one ended.
+ *
+ * @param input Mono input samples
+ * @param left0 Left gain before the first sample
+ * @param right0 Right gain before the first sample
+ * @param left1 Left gain of the last sample
+ * @param right1 Right gain of the last sample
+ * @param output [in/out] Interleaved stereo buffer to mix into
+ * @param n Number of input samples (stereo frames)
+ */
+void dsp_pan_mix_ramp(const float* input, float left0, float right0, float left1, float right1, float* output, size_t n);
+
+/**
+ * Fixed-point version of `dsp_pan_mix_ramp()` with Q15 gains.
+ *
+ * @param input Q15 mono input samples
+ * @param left0 Q15 left gain before the first sample
+ * @param right0 Q15 right gain before the first sample
+ * @param left1 Q15 left gain of the last sample
+ * @param right1 Q15 right gain of the last sample
+ * @param output [in/out] Interleaved Q15 stereo buffer to mix into
+ * @param n Number of input samples (stereo frames)
+ */
+void dsp_pan_mix_ramp_q15(const q15_t* input, q15_t left0, q15_t right0, q15_t left1, q15_t right1, int32_t* output, size_t n);
+
+/**
+ * Log-domain version of `dsp_pan_mix_ramp()`. The gains are attenuations, which are
+ * ramped linearly, giving an exponential ramp of the linear gains.
+ *
+ * @param input Mono input samples as signed attenuation
+ * @param left0 Left attenuation before the first sample
+ * @param right0 Right attenuation before the first sample
+ * @param left1 Left attenuation of the last sample
+ * @param right1 Right attenuation of the last sample
+ * @param output [in/out] Interleaved Q15 stereo buffer to mix into
+ * @param n Number of input samples (stereo frames)
+ */
+void dsp_pan_mix_ramp_log(const dsp_log_t* input, dsp_log_t left0, dsp_log_t right0, dsp_log_t left1, dsp_log_t right1, int32_t* output, size_t n);
+
 /**
  * Apply equal-power pan law to the given sample. The panning value ranges from
  * minus one to one from left to right. Algorithm from "The Audio Programming Book",
@@ -40,3 +90,75 @@ static inline void dsp_pan_stereo(float sample, float pan, float* left, float* r
     *left  = sample * dsp_wavetable_read2(dsp_pan_wt_cos, index);
     *right = sample * dsp_wavetable_read2(dsp_pan_wt_sin, index);
 }
+
+/**
+ * Fixed-point version of `dsp_pan_stereo()`. The Q15 panning value ranges from
+ * minus one to one from left to right.
+ *
+ * @param sample Q15 input sample
+ * @param pan Q15 pan value [-1 … 1]
+ * @param left [out] Q15 left output sample
+ * @param right [out] Q15 right output sample
+ */
+static inline void dsp_pan_stereo_q15(q15_t sample, q15_t pan, q15_t* left, q15_t* right) {
+    // (pan + 1) * 0.125 * length as Q16.16 with (pan + 1) in Q15 = pan + 32768
+    uint32_t index = ((uint32_t) (pan + 32768) * CONFIG_DSP_WAVETABLE_LENGTH) >> 2;
+
+    *left  = dsp_q15_mul(sample, dsp_wavetable_read2_q15(dsp_pan_wt_cos, index));
+    *right = dsp_q15_mul(sample, dsp_wavetable_read2_q15(dsp_pan_wt_sin, index));
+}
+
+/**
+ * Log-domain version of `dsp_pan_stereo()`. The cosine and sine gains of the pan law
+ * are read from the quarter-wave log-sine table and simply added to the sample.
+ *
+ * @param sample Input sample as signed attenuation
+ * @param pan Q15 pan value [-1 … 1]
+ * @param left [out] Left output sample as signed attenuation
+ * @param right [out] Right output sample as signed attenuation
+ */
+static inline void dsp_pan_stereo_log(dsp_log_t sample, q15_t pan, dsp_log_t* left, dsp_log_t* right) {
+    // (pan + 1) * 0.5 * quarter-wave length with (pan + 1) in Q15 = pan + 32768
+    uint32_t index = (uint32_t) (pan + 32768) >> 6;
+
+    *left  = sample + dsp_pan_wt_logsin->samples_u16[(DSP_WAVETABLE_LOGSIN_LENGTH - 1) - index];
+    *right = sample + dsp_pan_wt_logsin->samples_u16[index];
+}
+
+/**
+ * Left and right gains of the equal-power pan law for the given pan value.
+ * Same as calling `dsp_pan_stereo()` with a sample of one.
+ *
+ * @param pan Pan value [-1 … 1]
+ * @param left [out] Left gain
+ * @param right [out] Right gain
+ */
+static inline void dsp_pan_gains(float pan, float* left, float* right) {
+    dsp_pan_stereo(1.0f, pan, left, right);
+}
+
+/**
+ * Fixed-point version of `dsp_pan_gains()`.
+ *
+ * @param pan Q15 pan value [-1 … 1]
+ * @param left [out] Q15 left gain
+ * @param right [out] Q15 right gain
+ */
+static inline void dsp_pan_gains_q15(q15_t pan, q15_t* left, q15_t* right) {
+    // Same index as in `dsp_pan_stereo_q15()`, but without multiplying the sample
+    uint32_t index = ((uint32_t) (pan + 32768) * CONFIG_DSP_WAVETABLE_LENGTH) >> 2;
+
+    *left  = dsp_wavetable_read2_q15(dsp_pan_wt_cos, index);
+    *right = dsp_wavetable_read2_q15(dsp_pan_wt_sin, index);
+}
+
+/**
+ * Log-domain version of `dsp_pan_gains()`.
+ *
+ * @param pan Q15 pan value [-1 … 1]
+ * @param left [out] Left gain as attenuation
+ * @param right [out] Right gain as attenuation
+ */
+static inline void dsp_pan_gains_log(q15_t pan, dsp_log_t* left, dsp_log_t* right) {
+    dsp_pan_stereo_log(0, pan, left, right);
+}
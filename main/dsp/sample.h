@@ -0,0 +1,101 @@
+/*
+ * Klimper: ESP32 I²S Synthesizer Test / µDSP Library
+ * © 2024 Dennis Schulmeister-Zimolong <dennis@wpvs.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ */
+
+#pragma once
+
+#include <stdint.h>                         // int16_t, int32_t
+#include <math.h>                           // log2f()
+#include "sdkconfig.h"                      // CONFIG_DSP_ENGINE_xyz
+
+/**
+ * Fixed-point number types for the integer DSP functions. Q15 values cover the
+ * range [-1 … 1) with 15 fractional bits, Q31 values the same range with 31 bits.
+ * Q15 is used for audio samples, Q31 where small increments must be accumulated.
+ */
+typedef int16_t q15_t;
+typedef int32_t q31_t;
+
+#define DSP_Q15_ONE (32767)                 // Largest Q15 value (≈ 1.0)
+#define DSP_Q31_ONE (2147483647)            // Largest Q31 value (≈ 1.0)
+
+/**
+ * Log-domain sample as used by the DX7-style log-sine/exp tables. The lower bits contain
+ * the attenuation in 1/1024 octaves (-log2(|x|) * 1024), bit 31 the sign. Multiplying two
+ * samples thus becomes adding their attenuations, as long as at most one of them is signed.
+ * Attenuations at or above `DSP_LOG_SILENCE` (about -90 dB) are considered silence.
+ */
+typedef uint32_t dsp_log_t;
+
+#define DSP_LOG_OCTAVE  (1024)              // Attenuation of one octave (½ amplitude)
+#define DSP_LOG_SILENCE (15 * 1024)         // Attenuation where Q15 values become zero
+#define DSP_LOG_SIGN    (0x80000000)        // Sign bit
+
+/**
+ * Sample type of the audio buffers the synthesizer mixes into. The integer engines
+ * mix Q15 samples in 32-bit integers, so that there is enough headroom to add up
+ * all voices without overflow. Clipping happens only when converting to 16 bits.
+ */
+#if CONFIG_DSP_ENGINE_FLOAT
+    typedef float dsp_sample_t;
+#else
+    typedef int32_t dsp_sample_t;
+#endif
+
+/**
+ * Convert a float value to Q15 with saturation.
+ *
+ * @param value Float value [-1 … 1]
+ * @returns Q15 value
+ */
+static inline q15_t dsp_q15_from_float(float value) {
+    if (value >= 1.0f)  return DSP_Q15_ONE;
+    if (value <= -1.0f) return -DSP_Q15_ONE;
+    return (q15_t) (value * 32768.0f);
+}
+
+/**
+ * Convert a float value to Q31 with saturation.
+ *
+ * @param value Float value [-1 … 1]
+ * @returns Q31 value
+ */
+static inline q31_t dsp_q31_from_float(float value) {
+    if (value >= 1.0f)  return DSP_Q31_ONE;
+    if (value <= -1.0f) return -DSP_Q31_ONE;
+    return (q31_t) (value * 2147483648.0f);
+}
+
+/**
+ * Multiply two Q15 values.
+ *
+ * @param a First factor
+ * @param b Second factor
+ * @returns Product in Q15
+ */
+static inline q15_t dsp_q15_mul(q15_t a, q15_t b) {
+    return (q15_t) (((int32_t) a * b) >> 15);
+}
+
+/**
+ * Convert a positive gain factor to a log-domain attenuation. This is meant for
+ * control values like volumes, not for audio samples, as it calls `log2f()`.
+ *
+ * @param gain Gain factor [0 … 1]
+ * @returns Attenuation (never signed)
+ */
+static inline dsp_log_t dsp_log_from_float(float gain) {
+    if (gain <= 0.0f) return DSP_LOG_SILENCE;
+
+    float attenuation = -log2f(gain) * DSP_LOG_OCTAVE;
+    if (attenuation <= 0.0f) return 0;
+    if (attenuation >= DSP_LOG_SILENCE) return DSP_LOG_SILENCE;
+
+    return (dsp_log_t) (attenuation + 0.5f);
+}
@@ -10,6 +10,8 @@
 
 #pragma once
 
+#include <stdint.h>                                 // uint32_t
+
 #ifndef PI
     #define PI (3.14159265f)
 #endif
@@ -22,6 +24,14 @@
     #define HALF_PI (1.5707963f)
 #endif
 
+/**
+ * Let the compiler unroll the following loop `n` times, so that it can interleave the
+ * loads, multiplications and stores of consecutive samples or stereo frames. The trip
+ * count doesn't need to be a multiple of `n`, the remainder is handled by the compiler.
+ */
+#define DSP_UNROLL(n) DSP_PRAGMA(GCC unroll n)
+#define DSP_PRAGMA(x) _Pragma(#x)
+
 /**
  * Convert MIDI note number to frequency in Hz in the equal tempered scale
  * (using a frequency ratio of 2 ^ 1/12 per semitone). The MIDI note is given
@@ -31,3 +41,19 @@
  * @returns Frequency in Hz
  */
 float mtof(float midinote);
+
+/**
+ * Fast pseudo-random numbers with Marsaglia's xorshift32 algorithm: Three shifts
+ * and three XORs instead of the library call and the locking of `rand()`. Each user
+ * keeps their own state, which must not be zero.
+ *
+ * @param state [in/out] Generator state
+ * @returns Next pseudo-random number
+ */
+static inline uint32_t xorshift32(uint32_t* state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
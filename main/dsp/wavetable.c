@@ -9,19 +9,44 @@
  */
 
 #include "wavetable.h"
-#include "utils.h"                          // TWO_PI
+#include "utils.h"                          // TWO_PI, HALF_PI
 
 // Pre-defined wavetable functions and global singleton wavetables
 float dsp_wavetable_sin(float x) { return sin(x); }
 float dsp_wavetable_cos(float x) { return cos(x); }
+float dsp_wavetable_saw(float x) { return x / PI - 1.0f; }
+float dsp_wavetable_square(float x) { return x < PI ? 1.0f : -1.0f; }
 
-dsp_wavetable_t* default_wavetables[DSP_WAVETABLE_N] = {};
+float dsp_wavetable_triangle(float x) {
+    if (x < HALF_PI)        return x / HALF_PI;
+    if (x < PI + HALF_PI)   return 2.0f - x / HALF_PI;
+    return x / HALF_PI - 4.0f;
+}
+
+// Generated by tools/gen_wavetables.py into the build directory, see wavetables.c there
+extern dsp_wavetable_t* const dsp_wavetable_generated[DSP_WAVETABLE_N];
+
+#if CONFIG_DSP_WAVETABLE_MIPMAP_GENERATED
+extern dsp_wavetable_mipmap_t* const dsp_wavetable_mipmap_generated[DSP_WAVETABLE_MIPMAP_N];
+#else
+dsp_wavetable_mipmap_t* default_mipmaps[DSP_WAVETABLE_MIPMAP_N] = {};
 
-dsp_wavetable_func_ptr default_wavetable_funcs[DSP_WAVETABLE_N] = {
+dsp_wavetable_func_ptr default_mipmap_funcs[DSP_WAVETABLE_MIPMAP_N] = {
     // Array index must match the corresponding enum value!
-    dsp_wavetable_sin,
-    dsp_wavetable_cos,
+    dsp_wavetable_saw,
+    dsp_wavetable_square,
+    dsp_wavetable_triangle,
 };
+#endif
+
+#define DSP_WAVETABLE_MIPMAP_OVERSAMPLING (4) // Sampling of the naive waveform for the harmonic analysis
+
+// Harmonics of the waveform currently being synthesized by `dsp_wavetable_mipmap_series()`
+static struct {
+    size_t n;                               // Highest harmonic of the current level
+    float* cos;                             // Cosine amplitudes, index 0 is the DC offset
+    float* sin;                             // Sine amplitudes
+} mipmap_harmonics;
 
 /**
  * Create a new wavetable and fill it with values (with default options).
@@ -34,19 +59,64 @@ dsp_wavetable_t* dsp_wavetable_new(dsp_wavetable_func_ptr func) {
  * Create a new wavetable and fill it with values (with cusdom options).
  */
 dsp_wavetable_t* dsp_wavetable_new_custom(size_t length, size_t guards, dsp_wavetable_func_ptr func) {
-    dsp_wavetable_t* wavetable = malloc(sizeof(dsp_wavetable_t));
+    assert(length > 0 && length <= DSP_WAVETABLE_MAX_LENGTH);
+
+    dsp_wavetable_t* wavetable   = malloc(sizeof(dsp_wavetable_t));
+    float*           samples     = malloc((length + guards) * sizeof(float));
+    q15_t*           samples_q15 = malloc((length + guards) * sizeof(q15_t));
 
     wavetable->length = length;
-    wavetable->samples = malloc((length + guards) * sizeof(float));
+    wavetable->samples = samples;
+    wavetable->samples_q15 = samples_q15;
+    wavetable->samples_u16 = NULL;
 
     float incr = TWO_PI / length;
 
     for (unsigned int i = 0; i < length; i++) {
-        wavetable->samples[i] = func(i * incr);
+        samples[i] = func(i * incr);
     }
 
     for (unsigned int i = 0; i < guards; i++) {
-        wavetable->samples[length + i] = wavetable->samples[i];
+        samples[length + i] = samples[i];
+    }
+
+    for (unsigned int i = 0; i < length + guards; i++) {
+        samples_q15[i] = dsp_q15_from_float(samples[i]);
+    }
+
+    return wavetable;
+}
+
+/**
+ * Create a quarter-wave log-sine table.
+ */
+dsp_wavetable_t* dsp_wavetable_new_logsin(size_t length) {
+    dsp_wavetable_t* wavetable   = calloc(1, sizeof(dsp_wavetable_t));
+    uint16_t*        samples_u16 = malloc(length * sizeof(uint16_t));
+
+    wavetable->length = length;
+    wavetable->samples_u16 = samples_u16;
+
+    for (unsigned int i = 0; i < length; i++) {
+        float attenuation = -log2(sin((i + 0.5) / length * HALF_PI)) * DSP_LOG_OCTAVE;
+        samples_u16[i] = (uint16_t) (attenuation + 0.5f);
+    }
+
+    return wavetable;
+}
+
+/**
+ * Create an exponential table to convert log-domain values back to linear.
+ */
+dsp_wavetable_t* dsp_wavetable_new_exp2(size_t length) {
+    dsp_wavetable_t* wavetable   = calloc(1, sizeof(dsp_wavetable_t));
+    uint16_t*        samples_u16 = malloc(length * sizeof(uint16_t));
+
+    wavetable->length = length;
+    wavetable->samples_u16 = samples_u16;
+
+    for (unsigned int i = 0; i < length; i++) {
+        samples_u16[i] = (uint16_t) (pow(2.0, -(double) i / length) * DSP_Q15_ONE + 0.5);
     }
 
     return wavetable;
@@ -56,18 +126,151 @@ dsp_wavetable_t* dsp_wavetable_new_custom(size_t length, size_t guards, dsp_wave
  * Free memory of a given wavetable.
  */
 void dsp_wavetable_free(dsp_wavetable_t* wavetable) {
-    free(wavetable->samples);
+    free((void*) wavetable->samples);
+    free((void*) wavetable->samples_q15);
+    free((void*) wavetable->samples_u16);
     free(wavetable);
 }
 
 /**
- * Get a pointer to one of the default wavetables. Create if missing.
+ * Fourier series with the harmonics in `mipmap_harmonics`. Used as wavetable function
+ * to synthesize the mipmap levels. The harmonics cos(kx) and sin(kx) are calculated by
+ * successive rotation, so that only one sine and cosine is needed per sample.
  */
-dsp_wavetable_t* dsp_wavetable_get(dsp_wavetable_default_t which) {
-    if (default_wavetables[which] == NULL) {
-        default_wavetables[which] = dsp_wavetable_new(default_wavetable_funcs[which]);
+static float dsp_wavetable_mipmap_series(float x) {
+    float rot_cos = cosf(x), rot_sin = sinf(x);
+    float k_cos   = rot_cos, k_sin   = rot_sin;
+    float value   = mipmap_harmonics.cos[0];
+
+    for (size_t k = 1; k <= mipmap_harmonics.n; k++) {
+        value += mipmap_harmonics.cos[k] * k_cos + mipmap_harmonics.sin[k] * k_sin;
+
+        float next_cos = k_cos * rot_cos - k_sin * rot_sin;
+        k_sin = k_sin * rot_cos + k_cos * rot_sin;
+        k_cos = next_cos;
+    }
+
+    return value;
+}
+
+/**
+ * Create a band-limited wavetable from an arbitrary waveform.
+ */
+dsp_wavetable_mipmap_t* dsp_wavetable_mipmap_new(dsp_wavetable_func_ptr func) {
+    size_t length    = CONFIG_DSP_WAVETABLE_LENGTH;
+    size_t n_samples = length * DSP_WAVETABLE_MIPMAP_OVERSAMPLING;
+
+    dsp_wavetable_mipmap_t* mipmap = calloc(1, sizeof(dsp_wavetable_mipmap_t));
+    mipmap->max_harmonic = length / 2;
+    mipmap->n_levels     = __builtin_ctz(mipmap->max_harmonic) + 1;
+    mipmap->levels       = calloc(mipmap->n_levels, sizeof(dsp_wavetable_t*));
+
+    // Harmonic analysis (discrete Fourier transform) of the oversampled naive waveform.
+    // A sine table with the analysis length replaces the trigonometric functions.
+    float* samples = malloc(n_samples * sizeof(float));
+    float* sines   = malloc(n_samples * sizeof(float));
+
+    for (size_t i = 0; i < n_samples; i++) {
+        samples[i] = func(i * TWO_PI / n_samples);
+        sines[i]   = sinf(i * TWO_PI / n_samples);
+    }
+
+    mipmap_harmonics.cos = calloc(mipmap->max_harmonic + 1, sizeof(float));
+    mipmap_harmonics.sin = calloc(mipmap->max_harmonic + 1, sizeof(float));
+
+    for (size_t k = 0; k <= mipmap->max_harmonic; k++) {
+        float sum_cos = 0.0f, sum_sin = 0.0f;
+
+        for (size_t i = 0; i < n_samples; i++) {
+            size_t phase = (k * i) % n_samples;
+            sum_cos += samples[i] * sines[(phase + n_samples / 4) % n_samples];
+            sum_sin += samples[i] * sines[phase];
+        }
+
+        mipmap_harmonics.cos[k] = sum_cos * (k ? 2.0f : 1.0f) / n_samples;
+        mipmap_harmonics.sin[k] = sum_sin * 2.0f / n_samples;
+    }
+
+    free(samples);
+    free(sines);
+
+    // Synthesize one level per octave and find the overall peak
+    float peak = 0.0f;
+
+    for (size_t level = 0; level < mipmap->n_levels; level++) {
+        mipmap_harmonics.n = mipmap->max_harmonic >> level;
+        mipmap->levels[level] = dsp_wavetable_new_custom(length, 1, dsp_wavetable_mipmap_series);
+
+        for (size_t i = 0; i < length; i++) {
+            float value = fabsf(mipmap->levels[level]->samples[i]);
+            if (value > peak) peak = value;
+        }
+    }
+
+    free(mipmap_harmonics.cos);
+    free(mipmap_harmonics.sin);
+
+    // Scale all levels by the same factor, so that the volume doesn't change between octaves
+    if (peak > 1.0f) {
+        for (size_t level = 0; level < mipmap->n_levels; level++) {
+            float* samples     = (float*) mipmap->levels[level]->samples;
+            q15_t* samples_q15 = (q15_t*) mipmap->levels[level]->samples_q15;
+
+            for (size_t i = 0; i < length + 1; i++) {
+                samples[i]    /= peak;
+                samples_q15[i] = dsp_q15_from_float(samples[i]);
+            }
+        }
+    }
+
+    return mipmap;
+}
+
+/**
+ * Free memory of a given mipmap.
+ */
+void dsp_wavetable_mipmap_free(dsp_wavetable_mipmap_t* mipmap) {
+    for (size_t level = 0; level < mipmap->n_levels; level++) {
+        dsp_wavetable_free(mipmap->levels[level]);
+    }
+
+    free(mipmap->levels);
+    free(mipmap);
+}
+
+/**
+ * Get a pointer to one of the default mipmaps. Create if missing and not generated.
+ */
+dsp_wavetable_mipmap_t* dsp_wavetable_mipmap_get(dsp_wavetable_mipmap_default_t which) {
+#if CONFIG_DSP_WAVETABLE_MIPMAP_GENERATED
+    return dsp_wavetable_mipmap_generated[which];
+#else
+    if (default_mipmaps[which] == NULL) {
+        default_mipmaps[which] = dsp_wavetable_mipmap_new(default_mipmap_funcs[which]);
+    }
+
+    return default_mipmaps[which];
+#endif
+}
+
+/**
+ * Select the mipmap level for the given frequency.
+ */
+dsp_wavetable_t* dsp_wavetable_mipmap_select(dsp_wavetable_mipmap_t* mipmap, float frequency) {
+    float  max_harmonic = CONFIG_AUDIO_SAMPLE_RATE * 0.5f / frequency;
+    size_t level = 0;
+
+    while (level < mipmap->n_levels - 1 && (mipmap->max_harmonic >> level) > max_harmonic) {
+        level++;
     }
 
-    return default_wavetables[which];
+    return mipmap->levels[level];
+}
+
+/**
+ * Get a pointer to one of the default wavetables.
+ */
+dsp_wavetable_t* dsp_wavetable_get(dsp_wavetable_default_t which) {
+    return dsp_wavetable_generated[which];
 }
 
@@ -9,15 +9,40 @@
  */
 
 #pragma once
+#include <assert.h>                         // assert()
 #include <math.h>                           // sin(), cos(), …
 #include <stdlib.h>                         // size_t
+#include <stdint.h>                         // uint32_t
+#include "sample.h"                         // q15_t
 
 /**
- * A wavetable with sample values
+ * Longest wavetable the oscillators can play: The fixed-point oscillators keep the table
+ * index in signed Q16.16, which must hold the length plus the largest increment.
+ */
+#define DSP_WAVETABLE_MAX_LENGTH (16384)
+
+#if CONFIG_DSP_WAVETABLE_LENGTH & (CONFIG_DSP_WAVETABLE_LENGTH - 1)
+    #error The wavetable length must be a power of two for the phase accumulator of the oscillators!
+#endif
+
+#if CONFIG_DSP_WAVETABLE_LENGTH > DSP_WAVETABLE_MAX_LENGTH
+    #error The wavetable length must not exceed DSP_WAVETABLE_MAX_LENGTH!
+#endif
+
+#define DSP_WAVETABLE_LOGSIN_LENGTH (1024)  // Quarter-wave log-sine table length (10 bit)
+#define DSP_WAVETABLE_EXP2_LENGTH   (1024)  // Exponential table length (fraction of an octave)
+
+/**
+ * A wavetable with sample values. The samples are kept both as float and as Q15
+ * values, so that the wavetable can be used by the floating-point and fixed-point
+ * DSP functions alike. The log-domain tables only use the unsigned integer samples.
+ * The samples are read-only, since the built-in tables are constant arrays.
  */
 typedef struct {
-    size_t length;
-    float* samples;
+    size_t          length;
+    const float*    samples;
+    const q15_t*    samples_q15;
+    const uint16_t* samples_u16;
 } dsp_wavetable_t;
 
 /**
@@ -28,16 +53,49 @@ typedef float (*dsp_wavetable_func_ptr)(float);
 
 float dsp_wavetable_sin(float x);
 float dsp_wavetable_cos(float x);
+float dsp_wavetable_saw(float x);
+float dsp_wavetable_square(float x);
+float dsp_wavetable_triangle(float x);
 
 /**
  * Built-in default wavetables that can be accessed globaly with `dsp_wavetable_get()`.
+ * They are generated at build time by `tools/gen_wavetables.py` as constant arrays,
+ * which stay in flash or are placed in DRAM (`CONFIG_DSP_WAVETABLE_DRAM`).
  */
 typedef enum {
     DSP_WAVETABLE_SIN = 0,
     DSP_WAVETABLE_COS,
+    DSP_WAVETABLE_LOGSIN,                   // Quarter-wave -log2(sin(x)) table
+    DSP_WAVETABLE_EXP2,                     // 2^-x table to convert log values back
     DSP_WAVETABLE_N,                        // Dummy entry for the enum length
 } dsp_wavetable_default_t;
 
+/**
+ * Band-limited wavetable for waveforms with overtones, like saw or square waves. A naive
+ * wavetable of such a waveform aliases, as soon as its overtones exceed the Nyquist
+ * frequency. The mipmap therefor contains one wavetable per octave ("level"), each with
+ * half the number of harmonics of the previous one. Level 0 contains all harmonics that
+ * fit into the table length, the last level only the fundamental. All levels have the
+ * same length and one guard point, so that they can be used like any other wavetable.
+ */
+typedef struct {
+    size_t            n_levels;             // Number of levels (octaves)
+    size_t            max_harmonic;         // Highest harmonic of level 0 (halved with each level)
+    dsp_wavetable_t** levels;               // Wavetables from most to least harmonics
+} dsp_wavetable_mipmap_t;
+
+/**
+ * Built-in band-limited wavetables that can be accessed globally with `dsp_wavetable_mipmap_get()`.
+ * Like the default wavetables they are generated at build time, unless this is switched off with
+ * `CONFIG_DSP_WAVETABLE_MIPMAP_GENERATED` to save flash for long wavetables.
+ */
+typedef enum {
+    DSP_WAVETABLE_MIPMAP_SAW = 0,
+    DSP_WAVETABLE_MIPMAP_SQUARE,
+    DSP_WAVETABLE_MIPMAP_TRIANGLE,
+    DSP_WAVETABLE_MIPMAP_N,                 // Dummy entry for the enum length
+} dsp_wavetable_mipmap_default_t;
+
 /**
  * Create a new wavetable with default lenght (config option) and one guard point.
  * Fill the wavetable with values computed from the given wavetable function, which
@@ -50,7 +108,8 @@ dsp_wavetable_t* dsp_wavetable_new(dsp_wavetable_func_ptr func);
 /**
  * Create a new wavetable and fill it with values. Optionally add the given number
  * of guard points at the end, extending the wavetable length accordingly. The
- * length of the wavetable will be `CONFIG_DSP_WAVETABLE_LENGTH` bytes.
+ * length of the wavetable will be `CONFIG_DSP_WAVETABLE_LENGTH` bytes. Asserts that
+ * the length is between 1 and `DSP_WAVETABLE_MAX_LENGTH`.
  *
  * @param length Size of the new wavetable
  * @param guards Number of additional guard points
@@ -59,6 +118,26 @@ dsp_wavetable_t* dsp_wavetable_new(dsp_wavetable_func_ptr func);
  */
 dsp_wavetable_t* dsp_wavetable_new_custom(size_t length, size_t guards, dsp_wavetable_func_ptr func);
 
+/**
+ * Create a quarter-wave log-sine table like the one of the Yamaha DX7. For each index n
+ * it contains -log2(sin((n + 0.5) / length * π/2)) as `dsp_log_t` attenuation. The half
+ * step avoids the undefined value log(0) and the duplicated zero when mirroring.
+ * See: http://www.righto.com/2021/12/yamaha-dx7-reverse-engineering-part-iii.html
+ *
+ * @param length Number of entries for a quarter wave
+ * @returns Pointer to the new wavetable
+ */
+dsp_wavetable_t* dsp_wavetable_new_logsin(size_t length);
+
+/**
+ * Create an exponential table to convert log-domain values back to linear Q15 values.
+ * For each index n it contains 2^(-n / length) as Q15 value, covering one octave.
+ *
+ * @param length Number of entries for one octave
+ * @returns Pointer to the new wavetable
+ */
+dsp_wavetable_t* dsp_wavetable_new_exp2(size_t length);
+
 /**
  * Free memory of a given wavetable.
  *
@@ -67,15 +146,56 @@ dsp_wavetable_t* dsp_wavetable_new_custom(size_t length, size_t guards, dsp_wave
 void dsp_wavetable_free(dsp_wavetable_t* wavetable);
 
 /**
- * Get a pointer to one of the default wavetables. The wavetable will be created the first time
- * this function is called and must never be freed. It is essentially a global singleton so that
- * we don't need to have multiple copies of the same wavetable in memory.
+ * Get a pointer to one of the default wavetables. The wavetable is generated at build time
+ * and must never be freed. It is essentially a global singleton so that we don't need to
+ * have multiple copies of the same wavetable in memory.
  *
  * @param which Type of the requested wavetable
  * @returns Pointer to the global wavetable (don't free!)
  */
 dsp_wavetable_t* dsp_wavetable_get(dsp_wavetable_default_t which);
 
+/**
+ * Create a band-limited wavetable of default length from an arbitrary waveform. The
+ * waveform function is sampled with four times the table length and decomposed into its
+ * harmonics, from which each level is synthesized with `dsp_wavetable_new_custom()`
+ * up to its highest harmonic. Finally all levels are scaled by the same factor, so that
+ * the Gibbs overshoot of the band-limited waveform doesn't clip. This takes some time
+ * and should only be done at start-up.
+ *
+ * @param func Function to calculate the naive (not band-limited) waveform
+ * @returns Pointer to the new mipmap
+ */
+dsp_wavetable_mipmap_t* dsp_wavetable_mipmap_new(dsp_wavetable_func_ptr func);
+
+/**
+ * Free memory of a given mipmap including all of its levels.
+ *
+ * @param mipmap Mipmap instance
+ */
+void dsp_wavetable_mipmap_free(dsp_wavetable_mipmap_t* mipmap);
+
+/**
+ * Get a pointer to one of the built-in band-limited wavetables. Like with `dsp_wavetable_get()`
+ * the mipmap must never be freed. If it is not generated at build time, it is created the first
+ * time it is requested.
+ *
+ * @param which Type of the requested mipmap
+ * @returns Pointer to the global mipmap (don't free!)
+ */
+dsp_wavetable_mipmap_t* dsp_wavetable_mipmap_get(dsp_wavetable_mipmap_default_t which);
+
+/**
+ * Select the level of a mipmap whose harmonics all stay below the Nyquist frequency,
+ * when it is played with the given frequency. This is the level with the most harmonics
+ * that still fulfills the condition. Not meant to be called for each sample.
+ *
+ * @param mipmap Mipmap instance
+ * @param frequency Playback frequency in Hz
+ * @returns Wavetable of the selected level
+ */
+dsp_wavetable_t* dsp_wavetable_mipmap_select(dsp_wavetable_mipmap_t* mipmap, float frequency);
+
 /**
  * Read wavetable with linear interpolation. Note that the wavetable must have at
  * least one guard point for this to work. Otherwise a garbage value will be read
@@ -94,3 +214,55 @@ static inline float dsp_wavetable_read2(dsp_wavetable_t* wavetable, float index)
 
     return value + (slope * (index - iindex));
 }
+
+/**
+ * Fixed-point version of `dsp_wavetable_read2()`. The index is given in Q16.16 format,
+ * meaning that the upper 16 bits contain the integer index and the lower 16 bits the
+ * fraction between two samples.
+ *
+ * @param wavetable Wavetable instance
+ * @param index Q16.16 index
+ * @returns Linearly interpolated Q15 value
+ */
+static inline q15_t dsp_wavetable_read2_q15(dsp_wavetable_t* wavetable, uint32_t index) {
+    uint32_t iindex = index >> 16;
+    int32_t  value  = wavetable->samples_q15[iindex];
+    int32_t  slope  = wavetable->samples_q15[iindex + 1] - value;
+
+    return (q15_t) (value + ((slope * (int32_t) ((index & 0xFFFF) >> 1)) >> 15));
+}
+
+/**
+ * Read the log-sine table at the given phase. Bits 31 and 30 of the phase select the
+ * quadrant, the next ten bits the table entry, mirrored in the second and fourth quadrant.
+ * Only works with a `DSP_WAVETABLE_LOGSIN` table of default length.
+ *
+ * @param wavetable Log-sine table
+ * @param phase 32-bit phase (full range for one cycle)
+ * @returns Signed attenuation
+ */
+static inline dsp_log_t dsp_wavetable_read_logsin(dsp_wavetable_t* wavetable, uint32_t phase) {
+    uint32_t index  = (phase >> 20) & (DSP_WAVETABLE_LOGSIN_LENGTH - 1);
+    uint32_t mirror = (uint32_t) ((int32_t) (phase << 1) >> 31);
+
+    return wavetable->samples_u16[index ^ (mirror & (DSP_WAVETABLE_LOGSIN_LENGTH - 1))] | (phase & DSP_LOG_SIGN);
+}
+
+/**
+ * Convert a log-domain value back to a linear Q15 value. The fraction of an octave is
+ * looked up in the exponential table, the whole octaves are a simple right shift.
+ * Only works with a `DSP_WAVETABLE_EXP2` table of default length.
+ *
+ * @param wavetable Exponential table
+ * @param value Signed attenuation
+ * @returns Linear Q15 value
+ */
+static inline int32_t dsp_wavetable_read_exp2(dsp_wavetable_t* wavetable, dsp_log_t value) {
+    uint32_t attenuation = value & ~DSP_LOG_SIGN;
+    if (attenuation > DSP_LOG_SILENCE) attenuation = DSP_LOG_SILENCE;
+
+    int32_t sample = wavetable->samples_u16[attenuation & (DSP_WAVETABLE_EXP2_LENGTH - 1)] >> (attenuation >> 10);
+    int32_t sign   = (int32_t) value >> 31;
+
+    return (sample ^ sign) - sign;
+}
@@ -0,0 +1,47 @@
+/*
+ * Klimper: ESP32 I²S Synthesizer Test
+ * © 2024 Dennis Schulmeister-Zimolong <dennis@wpvs.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ */
+
+#include "event.h"
+
+#include <esp_log.h>                        // ESP_LOGx
+#include <stdlib.h>                         // calloc(), free()
+
+static const char* TAG = "event";           // Logging tag
+
+/**
+ * Create a new event queue.
+ */
+event_queue_t* event_queue_new(size_t capacity) {
+    ESP_LOGD(TAG, "Creating new event queue with %u events", (unsigned) capacity);
+
+    uint32_t length = 1;
+    while (length < capacity) length <<= 1;
+
+    event_queue_t* queue = calloc(1, sizeof(event_queue_t));
+    queue->events = calloc(length, sizeof(event_t));
+    queue->mask   = length - 1;
+
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+
+    ESP_LOGI(TAG, "Created event queue %p with %lu events", queue, (unsigned long) length);
+
+    return queue;
+}
+
+/**
+ * Delete an event queue.
+ */
+void event_queue_free(event_queue_t* queue) {
+    ESP_LOGD(TAG, "Freeing event queue %p", queue);
+
+    free(queue->events);
+    free(queue);
+}
@@ -0,0 +1,154 @@
+/*
+ * Klimper: ESP32 I²S Synthesizer Test
+ * © 2024 Dennis Schulmeister-Zimolong <dennis@wpvs.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ */
+
+#pragma once
+
+#include <stdatomic.h>                      // atomic_load_explicit(), atomic_store_explicit()
+#include <stdbool.h>                        // bool, true, false
+#include <stddef.h>                         // size_t
+#include <stdint.h>                         // uint8_t, uint32_t
+
+#define EVENT_NOW (0)                       // Time stamp for events that are due immediately
+
+/**
+ * Event types. The meaning of `note` and `value` depends on the type.
+ */
+typedef enum {
+    EVENT_NOTE_ON,                          // Note-on: `note`, velocity in `value` (0…1)
+    EVENT_NOTE_OFF,                         // Note-off: `note`
+    EVENT_SYNTH_VOLUME,                     // Synthesizer master volume: `value` (0…1)
+    EVENT_SEQUENCER_BPM,                    // Sequencer tempo: `value` in beats per minute
+    EVENT_SEQUENCER_RUNNING,                // Sequencer play state: `value` != 0 for playing
+    EVENT_SEQUENCER_TOGGLE,                 // Toggle the sequencer play state
+} event_type_t;
+
+/**
+ * A time-stamped control event sent to the DSP task. The time stamp is the sample
+ * time at which the event is due, counted in samples like `sequencer_process()` does.
+ * The DSP task splits its processing cycle at the event times, so that each event
+ * takes effect at exactly its sample. Producers without a notion of sample time use
+ * `EVENT_NOW`. Events of one queue must be sent in chronological order.
+ */
+typedef struct {
+    uint32_t time;                          // Sample time, when the event is due
+    uint8_t  type;                          // Event type (`event_type_t`)
+    uint8_t  note;                          // MIDI note number
+    float    value;                         // Velocity or parameter value
+} event_t;
+
+/**
+ * Wait-free single-producer/single-consumer ring buffer of events. Each task that sends
+ * events to the DSP task (UI, sequencer, MIDI, …) gets its own queue, so that no locks
+ * or critical sections are needed on either side. The producer only writes `head`, the
+ * consumer only writes `tail`. Both indices run freely and are masked on access, so that
+ * all slots can be used.
+ */
+typedef struct {
+    event_t* events;                        // Ring buffer
+    uint32_t mask;                          // Capacity - 1 (capacity is a power of two)
+
+    _Atomic uint32_t head;                  // Next slot to write (producer only)
+    _Atomic uint32_t tail;                  // Next slot to read (consumer only)
+    uint32_t dropped;                       // Number of events dropped because the queue was full (producer only)
+} event_queue_t;
+
+/**
+ * Create a new event queue.
+ *
+ * @param capacity Minimum number of events (rounded up to a power of two)
+ * @returns Pointer to the event queue
+ */
+event_queue_t* event_queue_new(size_t capacity);
+
+/**
+ * Delete an event queue as a replacement for `free()`. Neither the producer nor the
+ * consumer must use the queue anymore.
+ *
+ * @param queue Event queue
+ */
+void event_queue_free(event_queue_t* queue);
+
+/**
+ * Send an event. Must only be called by the single producer of the queue. Never blocks:
+ * If the queue is full the event is dropped and counted.
+ *
+ * @param queue Event queue
+ * @param event Event (will be copied)
+ * @returns `false` if the event was dropped
+ */
+static inline bool event_queue_push(event_queue_t* queue, const event_t* event) {
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+
+    if (head - tail > queue->mask) {
+        queue->dropped++;
+        return false;
+    }
+
+    queue->events[head & queue->mask] = *event;
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    return true;
+}
+
+/**
+ * Receive the next event. Must only be called by the single consumer of the queue.
+ * Never blocks.
+ *
+ * @param queue Event queue
+ * @param event Received event
+ * @returns `false` if the queue was empty
+ */
+static inline bool event_queue_pop(event_queue_t* queue, event_t* event) {
+    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+
+    if (head == tail) return false;
+
+    *event = queue->events[tail & queue->mask];
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+/**
+ * Get the next event without removing it from the queue. Must only be called by the
+ * single consumer of the queue. The returned pointer stays valid until the event is
+ * removed with `event_queue_pop()`.
+ *
+ * @param queue Event queue
+ * @returns Pointer to the next event or `NULL` if the queue is empty
+ */
+static inline const event_t* event_queue_peek(event_queue_t* queue) {
+    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+
+    if (head == tail) return NULL;
+    return &queue->events[tail & queue->mask];
+}
+
+/**
+ * Convenience function to send an event from its fields.
+ *
+ * @param queue Event queue
+ * @param time Sample time, when the event is due (or `EVENT_NOW`)
+ * @param type Event type
+ * @param note MIDI note number (if used by the event type)
+ * @param value Velocity or parameter value (if used by the event type)
+ * @returns `false` if the event was dropped
+ */
+static inline bool event_queue_send(event_queue_t* queue, uint32_t time, event_type_t type, int note, float value) {
+    event_t event = {
+        .time  = time,
+        .type  = type,
+        .note  = note,
+        .value = value,
+    };
+
+    return event_queue_push(queue, &event);
+}
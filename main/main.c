@@ -12,15 +12,26 @@
 #include <freertos/task.h>                  // TaskHandle_t
 #include <portmacro.h>                      // spinlock_t
 #include <esp_log.h>                        // ESP_LOGx
+#include <inttypes.h>                       // PRIu32
+#include <stdatomic.h>                      // atomic_exchange_explicit()
 #include <stdbool.h>                        // bool, true, false
+#include <string.h>                         // memset()
 
 #include "driver/audiohw.h"                 // audiohw_xyz
 #include "driver/midiio.h"                  // midiio_xyz
+#include "dsp/delay.h"                      // dsp_delay_xyz
 #include "dsp/wavetable.h"                  // dsp_wavetable_xyz
+#include "event.h"                          // event_xyz
 #include "ui/ui.h"                          // ui_xyz
 #include "synth.h"                          // synth_xyz
 #include "sequencer.h"                      // sequencer_xyz
 #include "midi.h"                           // midi_xyz
+#include "render.h"                         // render_xyz
+#include "profiler.h"                       // profiler_xyz
+#include "trace.h"                          // trace_xyz
+#include "bench.h"                          // bench_xyz
+
+static const char* TAG = "main";            // Logging tag
 
 // DSP task: Called by the audio hardware to generate new audio
 void dsp_task(void* parameters);
@@ -28,19 +39,49 @@ void dsp_task(void* parameters);
 static TaskHandle_t dsp_task_handle = NULL;
 
 // DSP Stuff
-static float dsp_buffer[CONFIG_AUDIO_N_SAMPLES_BUFFER] = {};
-
 static dsp_wavetable_t* wavetable = NULL;
 static synth_t*         synth     = NULL;
+static dsp_delay_t*     delay     = NULL;
 static sequencer_t*     sequencer = NULL;
+static midi_t*          midi      = NULL;
+static render_t*        render    = NULL;
+
+// Control events: One queue per producer task, drained by the DSP task
+static event_queue_t* ui_events        = NULL;
+static event_queue_t* sequencer_events = NULL;
+static event_queue_t* midi_events      = NULL;
+
+// User interface: The UI only changes its own copies of the parameters and sends them to the DSP task
+static float ui_bpm     = 80.0f;
+static float ui_volume  = 1.0f;
 
-void cb_sequencer_set_bpm()    { sequencer_set_bpm(sequencer, sequencer->params.bpm); }
-void cb_sequencer_start_stop() { sequencer_set_running(sequencer, !sequencer->params.running); }
+void ui_send_event(event_type_t type, float value) {
+    if (!event_queue_send(ui_events, EVENT_NOW, type, 0, value)) {
+        ESP_LOGW(TAG, "Event queue full, UI event dropped");
+    }
+}
+
+void cb_sequencer_set_bpm()    { ui_send_event(EVENT_SEQUENCER_BPM, ui_bpm); }
+void cb_sequencer_start_stop() { ui_send_event(EVENT_SEQUENCER_TOGGLE, 0.0f); }
+void cb_synth_set_volume()     { ui_send_event(EVENT_SYNTH_VOLUME, ui_volume); }
+
+// MIDI volume changes are only stored by the DSP task, so that only the UI task writes its copy
+void cb_synth_sync_volume() {
+    float volume = atomic_exchange_explicit(&render->state.midi_volume, -1.0f, memory_order_relaxed);
+    if (volume >= 0.0f) ui_volume = volume;
+}
+void cb_profiler_info(char* line1, char* line2, void* arg) { profiler_format_lcd(line1, line2); }
+void cb_trace_dump()           { trace_dump(); }
 
 /**
  * Application entry point
  */
 void app_main(void) {
+#if CONFIG_BENCH_ON_TARGET
+    // Run benchmarks before anything else competes for the CPU
+    bench_run_on_target();
+#endif
+
     // Create wavetable. Note that we are using cosine instead of sine so that we still
     // get values at the Nyquist frequency (sample rate * 0.5). Because there the wavetable
     // will only be read at the first and middle position which with a sine would be zero.
@@ -51,7 +92,7 @@ void app_main(void) {
     float fm_ratios[] = {1.0f};
 
     synth_config_t synth_config = {
-        .volume    = 1.0,
+        .volume    = ui_volume,
         .wavetable = wavetable,
 
         .env1 = {
@@ -76,48 +117,112 @@ void app_main(void) {
             .index_min = 0.25f,
             .index_max = 0.75f,
         },
+
+        .algorithm = 0,
     };
 
     synth = synth_new(&synth_config);
 
+    // Create chorus effect for the mixed voices
+#if CONFIG_EFFECT_DELAY_ENABLE
+    dsp_delay_values_t delay_values = {
+        .delay    = 0.015f,
+        .depth    = 0.004f,
+        .rate     = 0.8f,
+        .feedback = 0.2f,
+        .mix      = 0.35f,
+    };
+
+    delay = dsp_delay_new(CONFIG_EFFECT_DELAY_MAX_MS / 1000.0f);
+
+    if (delay) {
+        dsp_delay_set_values(delay, &delay_values);
+        ESP_LOGI(TAG, "Delay lines of %u frames in %s", (unsigned) delay->length, delay->psram ? "PSRAM" : "internal RAM");
+    } else {
+        ESP_LOGE(TAG, "Not enough memory for the delay lines, effect disabled");
+    }
+#endif
+
+    // Create event queues
+    ui_events        = event_queue_new(CONFIG_EVENT_QUEUE_LENGTH);
+    sequencer_events = event_queue_new(CONFIG_EVENT_QUEUE_LENGTH);
+    midi_events      = event_queue_new(CONFIG_EVENT_QUEUE_LENGTH);
+
     // Create sequencer
     int notes[] = {60, 62, 64, 65, 67, 69, 71, 72};
 
     sequencer_config_t sequencer_config = {
-        .synth   = synth,
+        .events  = sequencer_events,
         .n_notes = sizeof(notes) / sizeof(int),
         .notes   = notes,
     };
 
     sequencer = sequencer_new(&sequencer_config);
-    sequencer_set_bpm(sequencer, 80);
+    sequencer_set_bpm(sequencer, ui_bpm);
     sequencer_set_running(sequencer, true);
 
+    // Initialize MIDI I/O. The received bytes are read by the DSP task itself.
+#if CONFIG_MIDI_ENABLE
+    midiio_config_t midiio_config = {
+        .uart_num       = CONFIG_MIDI_UART_NUM,
+        .rx_io          = CONFIG_MIDI_RX_GPIO,
+        .rx_buffer_size = 256,
+    };
+
+    midiio_init(&midiio_config);
+
+    midi_config_t midi_config = {
+        .events  = midi_events,
+        .channel = CONFIG_MIDI_CHANNEL,
+    };
+
+    midi = midi_new(&midi_config);
+#endif
+
+    // Create processing cycle of the DSP task
+    render_config_t render_config = {
+        .synth            = synth,
+        .sequencer        = sequencer,
+        .delay            = delay,
+        .ui_events        = ui_events,
+        .sequencer_events = sequencer_events,
+        .midi_events      = midi_events,
+    };
+
+    render = render_new(&render_config);
+
     // Initialize audio hardware and mixer task. This must happen after the DSP
     // and synthesizer to avoid using the DSP objects before they are initialized.
-    xTaskCreatePinnedToCore(
-        /* pvTaskCode    */ dsp_task,
-        /* pcName        */ "dsp_task",
-        /* uxStackDepth  */ 3584,
-        /* pvParameters  */ NULL,
-        /* uxPriority    */ configMAX_PRIORITIES - 1,
-        /* pxCreatedTask */ &dsp_task_handle,
-        /* xCoreID       */ 1
-    );
-
+    // The DMA buffers sent until the DSP task starts simply wait in the queue.
     audiohw_config_t audiohw_config = {
         .sample_rate = CONFIG_AUDIO_SAMPLE_RATE,
         .n_samples   = CONFIG_AUDIO_N_SAMPLES_BUFFER,
+        .n_buffers   = CONFIG_AUDIO_N_DMA_BUFFERS,
         .i2s_mck_io  = CONFIG_I2S_MCLK_GPIO,
         .i2s_lrc_io  = CONFIG_I2S_WSEL_GPIO,
         .i2s_bck_io  = CONFIG_I2S_BCLK_GPIO,
         .i2s_dout_io = CONFIG_I2S_DOUT_GPIO,
-        .dsp_task    = dsp_task_handle,
     };
 
     audiohw_init(&audiohw_config);
 
-    // TODO: Initialize MIDI I/O.
+    profiler_config_t profiler_config = {
+        .sample_rate = CONFIG_AUDIO_SAMPLE_RATE,
+        .n_buffers   = CONFIG_AUDIO_N_DMA_BUFFERS,
+    };
+
+    profiler_init(&profiler_config);
+    trace_init();
+
+    xTaskCreatePinnedToCore(
+        /* pvTaskCode    */ dsp_task,
+        /* pcName        */ "dsp_task",
+        /* uxStackDepth  */ 5120,
+        /* pvParameters  */ NULL,
+        /* uxPriority    */ configMAX_PRIORITIES - 1,
+        /* pxCreatedTask */ &dsp_task_handle,
+        /* xCoreID       */ 1
+    );
 
     // Initialize (hardware) user interface
     ui_command_t main_commands[] = {
@@ -131,7 +236,7 @@ void app_main(void) {
             .button_io = CONFIG_UI_BTN_SEQ_BPM_GPIO,
             .cb.value  = cb_sequencer_set_bpm,
             .param = {
-                .value = &sequencer->params.bpm,
+                .value = &ui_bpm,
                 .min   = 1.0f,
                 .max   = 280.0f,
                 .step  = 1.0f,
@@ -140,13 +245,27 @@ void app_main(void) {
         {
             .name      = "Master Volume",
             .button_io = CONFIG_UI_BTN_SYNTH_VOLUME_GPIO,
+            .cb.value  = cb_synth_set_volume,
+            .cb.sync   = cb_synth_sync_volume,
             .param = {
-                .value = &synth->params.volume,
+                .value = &ui_volume,
                 .min   = 0.0f,
                 .max   = 1.0f,
                 .step  = 0.05f,
             },
         },
+#if CONFIG_PROFILER_ENABLE
+        {
+            .name    = "DSP Load",
+            .cb.info = cb_profiler_info,
+        },
+#endif
+#if CONFIG_TRACE_ENABLE
+        {
+            .name       = "Dump Trace",
+            .cb.execute = cb_trace_dump,
+        },
+#endif
     };
 
     ui_config_t ui_config = {
@@ -166,33 +285,58 @@ void app_main(void) {
 }
 
 /**
- * Background task woken up by the audio hardware whenever new audio data
- * is needed. The DSP task then calls the actual DSP functions to produce
- * a new chunk of audio data.
+ * Background task woken up by the audio hardware whenever a DMA buffer has been
+ * sent and needs new audio data. The DSP task then calls the actual DSP functions
+ * to produce the audio data, one processing cycle at a time. Thus the DMA buffer
+ * size can be chosen independently from the processing cycle.
+ *
+ * While everything is silent, the cycles are not rendered at all. It is enough to
+ * clear each DMA buffer of the ring once, as the driver sends them again unchanged.
  */
 void dsp_task(void* parameters) {
+    uint32_t overruns       = 0;
+    size_t   silent_buffers = 0;                // Consecutive DMA buffers left silent
+
     while (true) {
-        audiohw_buffer_t tx_buffer = *(audiohw_buffer_t*) ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        audiohw_buffer_t tx_buffer;
+        audiohw_next_buffer(&tx_buffer, portMAX_DELAY);
+        trace_record(TRACE_DSP_BEGIN, 0);
+        profiler_begin_block(tx_buffer.queued_us);
 
-        for (size_t i = 0; i < CONFIG_AUDIO_N_SAMPLES_BUFFER; i++) {
-            dsp_buffer[i] = 0.0f;
-        }
+        size_t silent_samples = 0;
+
+        for (size_t offset = 0; offset < tx_buffer.size; offset += CONFIG_AUDIO_N_SAMPLES_CYCLE) {
+            size_t n_samples = tx_buffer.size - offset;
+            if (n_samples > CONFIG_AUDIO_N_SAMPLES_CYCLE) n_samples = CONFIG_AUDIO_N_SAMPLES_CYCLE;
 
-        for (size_t n_samples_processed = 0; n_samples_processed < CONFIG_AUDIO_N_SAMPLES_BUFFER; n_samples_processed += CONFIG_AUDIO_N_SAMPLES_CYCLE) {
-            sequencer_process(sequencer, CONFIG_AUDIO_N_SAMPLES_CYCLE);
-            synth_process(synth, dsp_buffer + n_samples_processed, CONFIG_AUDIO_N_SAMPLES_CYCLE);
+#if CONFIG_MIDI_ENABLE
+            midi_process(midi, render->state.clock);
+#endif
+
+            if (!render_cycle(render, tx_buffer.data + offset, n_samples)) {
+                if (silent_buffers < CONFIG_AUDIO_N_DMA_BUFFERS) {
+                    memset(tx_buffer.data + offset, 0, n_samples * sizeof(audiohw_sample_t));
+                }
+
+                silent_samples += n_samples;
+            }
         }
 
-        for (int i = 0; (i < CONFIG_AUDIO_N_SAMPLES_BUFFER) && (i < tx_buffer.size); i++) {
-            // NOTE: The assumption here is that the buffer provided by the audio hardware has the
-            // same size as the DSP buffer used here. There is a maximum limit of how big a DMA buffer
-            // can be on the ESP32. But we assume that as real-time application we are below that limit.
-            float sample = dsp_buffer[i];
+        // Once all buffers of the ring have been cleared, the silent cycles need no memset
+        if (silent_samples < tx_buffer.size) silent_buffers = 0;
+        else if (silent_buffers < CONFIG_AUDIO_N_DMA_BUFFERS) silent_buffers++;
+
+        profiler_end_block(tx_buffer.size);
+        trace_record(TRACE_DSP_END, 0);
 
-            if (sample < -1.0f) sample = -1.0f;
-            else if (sample > 1.0f) sample = 1.0f;
+#if CONFIG_SYNTH_GOVERNOR
+        synth_govern(synth, profiler_get_block_load());
+#endif
 
-            tx_buffer.data[i] = (int16_t) (roundf(32767.0f * sample));
+        if (audiohw_get_overruns() != overruns) {
+            overruns       = audiohw_get_overruns();
+            silent_buffers = 0;                 // The dropped buffer may still hold old audio
+            ESP_LOGW(TAG, "DSP task too late, %" PRIu32 " audio buffers dropped so far", overruns);
         }
     }
 }
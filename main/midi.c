@@ -9,3 +9,183 @@
  */
 
 #include "midi.h"
+
+#include <esp_log.h>                        // ESP_LOGx
+#include <stdbool.h>                        // bool, true, false
+#include <stdlib.h>                         // calloc(), free()
+#include "driver/midiio.h"                  // midiio_read()
+
+static const char* TAG = "midi";            // Logging tag
+
+#define MIDI_NOTE_OFF       (0x80)          // Channel voice messages (upper nibble)
+#define MIDI_NOTE_ON        (0x90)
+#define MIDI_CONTROL_CHANGE (0xB0)
+#define MIDI_PROGRAM_CHANGE (0xC0)
+#define MIDI_CHANNEL_PRESS  (0xD0)
+
+#define MIDI_SYSEX          (0xF0)          // System common messages
+#define MIDI_TIME_CODE      (0xF1)
+#define MIDI_SONG_POSITION  (0xF2)
+#define MIDI_SONG_SELECT    (0xF3)
+
+#define MIDI_CLOCK          (0xF8)          // System real-time messages
+#define MIDI_START          (0xFA)
+#define MIDI_CONTINUE       (0xFB)
+#define MIDI_STOP           (0xFC)
+
+#define MIDI_CC_VOLUME      (7)             // Channel volume controller
+
+#define MIDI_READ_CHUNK     (32)            // Bytes read from the hardware at once
+
+/**
+ * Create a new MIDI input instance.
+ */
+midi_t* midi_new(midi_config_t* config) {
+    ESP_LOGD(TAG, "Creating new MIDI input instance");
+
+    midi_t* midi = calloc(1, sizeof(midi_t));
+    midi->params.events  = config->events;
+    midi->params.channel = config->channel;
+
+    ESP_LOGI(TAG, "Created MIDI input instance %p on channel %i", midi, midi->params.channel);
+
+    return midi;
+}
+
+/**
+ * Delete a MIDI input instance.
+ */
+void midi_free(midi_t* midi) {
+    ESP_LOGD(TAG, "Freeing MIDI input instance %p", midi);
+    free(midi);
+}
+
+/**
+ * Number of data bytes following the given status byte.
+ */
+static inline int midi_data_length(uint8_t status) {
+    switch (status & 0xF0) {
+        case MIDI_PROGRAM_CHANGE:
+        case MIDI_CHANNEL_PRESS:
+            return 1;
+
+        case 0xF0:
+            if (status == MIDI_TIME_CODE || status == MIDI_SONG_SELECT) return 1;
+            if (status == MIDI_SONG_POSITION) return 2;
+            return 0;
+
+        default:
+            return 2;
+    }
+}
+
+/**
+ * Handle a complete message with all of its data bytes.
+ */
+static void midi_handle_message(midi_t* midi, uint8_t status, const uint8_t* data, uint32_t time) {
+    int channel = (status & 0x0F) + 1;
+    if (status >= 0xF0) return;
+    if (midi->params.channel != MIDI_OMNI && channel != midi->params.channel) return;
+
+    switch (status & 0xF0) {
+        case MIDI_NOTE_ON:
+            if (data[1] > 0) {
+                event_queue_send(midi->params.events, time, EVENT_NOTE_ON, data[0], data[1] / 127.0f);
+                break;
+            }
+            // Note-on with velocity zero is a note-off (used with running status)
+            // fall through
+
+        case MIDI_NOTE_OFF:
+            event_queue_send(midi->params.events, time, EVENT_NOTE_OFF, data[0], 0.0f);
+            break;
+
+        case MIDI_CONTROL_CHANGE:
+            if (data[0] == MIDI_CC_VOLUME) {
+                event_queue_send(midi->params.events, time, EVENT_SYNTH_VOLUME, 0, data[1] / 127.0f);
+            }
+            break;
+    }
+}
+
+/**
+ * Handle a real-time message. These are single bytes that can appear anywhere, even
+ * between the data bytes of another message, and don't change the running status.
+ */
+static void midi_handle_realtime(midi_t* midi, uint8_t status, uint32_t time) {
+    switch (status) {
+        case MIDI_CLOCK:
+            midi->state.clocks++;
+            break;
+
+        case MIDI_START:
+            midi->state.clocks = 0;
+            // fall through
+
+        case MIDI_CONTINUE:
+            event_queue_send(midi->params.events, time, EVENT_SEQUENCER_RUNNING, 0, 1.0f);
+            break;
+
+        case MIDI_STOP:
+            event_queue_send(midi->params.events, time, EVENT_SEQUENCER_RUNNING, 0, 0.0f);
+            break;
+    }
+}
+
+/**
+ * Parse received MIDI bytes.
+ */
+void midi_parse(midi_t* midi, const uint8_t* data, size_t length, uint32_t time) {
+    for (size_t i = 0; i < length; i++) {
+        uint8_t byte = data[i];
+
+        if (byte >= MIDI_CLOCK) {
+            midi_handle_realtime(midi, byte, time);
+            continue;
+        }
+
+        if (byte & 0x80) {
+            // New status byte. System common messages without data bytes (end of exclusive,
+            // tune request) only cancel the running status.
+            bool has_data = byte < 0xF0 || byte == MIDI_SYSEX || midi_data_length(byte) > 0;
+
+            midi->state.status = has_data ? byte : 0;
+            midi->state.n_data = 0;
+            continue;
+        }
+
+        // Data byte: Ignored without status and inside system exclusive messages
+        if (!midi->state.status || midi->state.status == MIDI_SYSEX) continue;
+
+        midi->state.data[midi->state.n_data++] = byte;
+        if (midi->state.n_data < midi_data_length(midi->state.status)) continue;
+
+        midi_handle_message(midi, midi->state.status, midi->state.data, time);
+        midi->state.n_data = 0;
+
+        // Only channel messages have a running status
+        if (midi->state.status >= 0xF0) midi->state.status = 0;
+    }
+}
+
+/**
+ * Read and parse received MIDI bytes.
+ */
+void midi_process(midi_t* midi, uint32_t time) {
+    uint8_t data[MIDI_READ_CHUNK];
+    size_t  length;
+
+    while ((length = midiio_read(data, sizeof(data))) > 0) {
+        midi_parse(midi, data, length, time);
+
+        // Bytes have been lost after the ones still buffered: Don't apply the running status
+        // to the data bytes of a message whose status byte may be missing
+        uint32_t overflows = midiio_get_overflows();
+
+        if (overflows != midi->state.overflows) {
+            midi->state.overflows = overflows;
+            midi->state.status    = 0;
+            midi->state.n_data    = 0;
+        }
+    }
+}
@@ -9,3 +9,75 @@
  */
 
 #pragma once
+
+#include <stddef.h>                         // size_t
+#include <stdint.h>                         // uint8_t, uint32_t
+#include "event.h"                          // event_xyz
+
+#define MIDI_OMNI (0)                       // Channel number to receive on all channels
+
+/**
+ * MIDI input: A byte-level parser for MIDI 1.0 messages, that turns the received note
+ * messages into time-stamped events for the DSP task. Running status is supported,
+ * real-time messages (clock, start, stop, …) can appear in the middle of any other
+ * message without disturbing it, and system exclusive messages are skipped. The parser
+ * works on a fixed state and never allocates memory.
+ */
+typedef struct {
+    struct {
+        event_queue_t* events;              // Event queue for the received notes (not freed)
+        int            channel;             // MIDI channel 1…16 or `MIDI_OMNI`
+    } params;
+
+    struct {
+        uint8_t  status;                    // Current (running) status byte or zero
+        uint8_t  data[2];                   // Data bytes of the current message
+        uint8_t  n_data;                    // Number of data bytes received so far
+        uint32_t clocks;                    // Number of received MIDI clock ticks (24 per quarter note)
+        uint32_t overflows;                 // Number of MIDI input overflows already handled
+    } state;
+} midi_t;
+
+/**
+ * Configuration parameters for MIDI input.
+ */
+typedef struct {
+    event_queue_t* events;                  // Event queue for the received notes (not freed by `midi_free()`)
+    int            channel;                 // MIDI channel 1…16 or `MIDI_OMNI`
+} midi_config_t;
+
+/**
+ * Create a new MIDI input instance.
+ *
+ * @param config Configuration parameters (can be freed afterwards)
+ * @returns Pointer to the MIDI input instance
+ */
+midi_t* midi_new(midi_config_t* config);
+
+/**
+ * Delete a MIDI input instance as a replacement for `free()`.
+ *
+ * @param midi MIDI input instance
+ */
+void midi_free(midi_t* midi);
+
+/**
+ * Parse received MIDI bytes and send an event for each complete note or control message.
+ * Incomplete messages are continued with the next call.
+ *
+ * @param midi MIDI input instance
+ * @param data Received bytes
+ * @param length Number of received bytes
+ * @param time Sample time for the sent events
+ */
+void midi_parse(midi_t* midi, const uint8_t* data, size_t length, uint32_t time);
+
+/**
+ * Read all bytes received by the MIDI hardware since the last call and parse them.
+ * Must be called by the producer task of the event queue, e.g. the DSP task at the
+ * beginning of each processing cycle, which bounds the latency to one cycle.
+ *
+ * @param midi MIDI input instance
+ * @param time Sample time for the sent events
+ */
+void midi_process(midi_t* midi, uint32_t time);
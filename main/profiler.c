@@ -0,0 +1,237 @@
+/*
+ * Klimper: ESP32 I²S Synthesizer Test
+ * © 2024 Dennis Schulmeister-Zimolong <dennis@wpvs.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ */
+
+#include "profiler.h"
+
+#include <freertos/FreeRTOS.h>              // Common FreeRTOS (must come first)
+#include <freertos/task.h>                  // xTaskCreatePinnedToCore(), vTaskDelay()
+#include <esp_attr.h>                       // IRAM_ATTR
+#include <esp_cpu.h>                        // esp_cpu_get_cycle_count()
+#include <esp_log.h>                        // ESP_LOGx
+#include <esp_timer.h>                      // esp_timer_get_time()
+#include <inttypes.h>                       // PRIu32
+#include <stdio.h>                          // snprintf()
+#include <string.h>                         // memset()
+#include "driver/audiohw.h"                 // audiohw_get_overruns()
+
+static const char* TAG = "profiler";        // Logging tag
+
+#define PROFILER_WINDOW_US (1000000)        // Length of the measurement window
+
+static profiler_config_t profiler_config;   // Configuration (global copy)
+static portMUX_TYPE      profiler_mux = portMUX_INITIALIZER_UNLOCKED;
+static profiler_stats_t  profiler_stats;   // Statistics of the last completed window
+
+#if CONFIG_PROFILER_ENABLE
+/**
+ * Running measurement of the DSP task. Only accessed by the DSP task itself, so
+ * that no locking is needed, except when the window is published.
+ */
+static struct {
+    int64_t  window_start_us;               // System time when the window has started
+    int64_t  queued_us;                     // System time when the current block was queued
+    uint32_t block_start;                   // CPU cycles at the start of the current block
+    uint32_t synth_start;                   // CPU cycles at the start of `synth_process()`
+    uint32_t synth_cycles;                  // CPU cycles spent in `synth_process()` in this block
+    uint32_t effects_start;                 // CPU cycles at the start of the effects
+    uint32_t effects_cycles;                // CPU cycles spent in the effects in this block
+
+    uint32_t n_blocks;                      // Number of blocks in this window
+    uint32_t cycles_min;                    // Minimum CPU cycles per block
+    uint32_t cycles_max;                    // Maximum CPU cycles per block
+    uint64_t cycles_sum;                    // Sum of the CPU cycles per block
+    uint64_t synth_cycles_sum;              // Sum of the CPU cycles in `synth_process()`
+    uint64_t effects_cycles_sum;            // Sum of the CPU cycles in the effects
+    uint64_t period_cycles_sum;             // Sum of the block periods in CPU cycles
+    float    load_min;                      // Minimum DSP load
+    float    load_max;                      // Maximum DSP load
+    float    load_last;                     // DSP load of the last block
+    uint64_t latency_sum_us;                // Sum of the ISR to task latencies
+    uint32_t latency_max_us;                // Maximum ISR to task latency
+    uint32_t deadline_misses;               // Blocks finished too late since startup
+} window;
+#endif
+
+#if CONFIG_PROFILER_ENABLE && CONFIG_PROFILER_LOG_INTERVAL > 0
+static void profiler_task(void* parameters);
+#endif
+
+/**
+ * Initialize profiler.
+ */
+void profiler_init(profiler_config_t* config) {
+    profiler_config = *config;
+
+#if CONFIG_PROFILER_ENABLE && CONFIG_PROFILER_LOG_INTERVAL > 0
+    xTaskCreatePinnedToCore(
+        /* pvTaskCode    */ profiler_task,
+        /* pcName        */ "profiler_task",
+        /* uxStackDepth  */ 3072,
+        /* pvParameters  */ NULL,
+        /* uxPriority    */ 1,
+        /* pxCreatedTask */ NULL,
+        /* xCoreID       */ 0
+    );
+#endif
+}
+
+/**
+ * Get statistics of the last measurement window.
+ */
+void profiler_get_stats(profiler_stats_t* stats) {
+    taskENTER_CRITICAL(&profiler_mux);
+    *stats = profiler_stats;
+    taskEXIT_CRITICAL(&profiler_mux);
+
+    stats->overruns = audiohw_get_overruns();
+}
+
+/**
+ * Format statistics for the LCD display.
+ */
+void profiler_format_lcd(char* line1, char* line2) {
+    profiler_stats_t stats;
+    profiler_get_stats(&stats);
+
+    snprintf(line1, 17, "DSP %2.0f/%2.0f/%2.0f%%", stats.load_min, stats.load_avg, stats.load_max);
+    snprintf(line2, 17, "%" PRIu32 "us L%" PRIu32 " O%" PRIu32, stats.latency_max_us, stats.deadline_misses, stats.overruns);
+}
+
+#if CONFIG_PROFILER_ENABLE
+/**
+ * Start measuring a new block.
+ */
+void IRAM_ATTR profiler_begin_block(int64_t queued_us) {
+    window.block_start    = esp_cpu_get_cycle_count();
+    window.queued_us      = queued_us;
+    window.synth_cycles   = 0;
+    window.effects_cycles = 0;
+
+    uint32_t latency_us = (uint32_t) (esp_timer_get_time() - queued_us);
+    window.latency_sum_us += latency_us;
+    if (latency_us > window.latency_max_us) window.latency_max_us = latency_us;
+}
+
+/**
+ * Start measuring `synth_process()`.
+ */
+void IRAM_ATTR profiler_begin_synth() {
+    window.synth_start = esp_cpu_get_cycle_count();
+}
+
+/**
+ * Stop measuring `synth_process()`.
+ */
+void IRAM_ATTR profiler_end_synth() {
+    window.synth_cycles += esp_cpu_get_cycle_count() - window.synth_start;
+}
+
+/**
+ * Start measuring the effects.
+ */
+void IRAM_ATTR profiler_begin_effects() {
+    window.effects_start = esp_cpu_get_cycle_count();
+}
+
+/**
+ * Stop measuring the effects.
+ */
+void IRAM_ATTR profiler_end_effects() {
+    window.effects_cycles += esp_cpu_get_cycle_count() - window.effects_start;
+}
+
+/**
+ * Finish measuring the current block. Once per window the statistics are published.
+ */
+void IRAM_ATTR profiler_end_block(size_t n_samples) {
+    uint32_t cycles = esp_cpu_get_cycle_count() - window.block_start;
+    int64_t  now_us = esp_timer_get_time();
+
+    // The block must be ready before the DMA controller has played all other buffers
+    uint32_t period_us     = (uint32_t) ((int64_t) n_samples / 2 * 1000000 / profiler_config.sample_rate);
+    uint32_t period_cycles = period_us * CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+    float    load          = 100.0f * cycles / period_cycles;
+
+    window.load_last = load;
+
+    if (now_us - window.queued_us > (int64_t) period_us * (profiler_config.n_buffers - 1)) {
+        window.deadline_misses++;
+    }
+
+    if (window.n_blocks == 0 || cycles < window.cycles_min) window.cycles_min = cycles;
+    if (window.n_blocks == 0 || cycles > window.cycles_max) window.cycles_max = cycles;
+    if (window.n_blocks == 0 || load < window.load_min) window.load_min = load;
+    if (window.n_blocks == 0 || load > window.load_max) window.load_max = load;
+
+    window.n_blocks++;
+    window.cycles_sum         += cycles;
+    window.synth_cycles_sum   += window.synth_cycles;
+    window.effects_cycles_sum += window.effects_cycles;
+    window.period_cycles_sum  += period_cycles;
+
+    if (now_us - window.window_start_us < PROFILER_WINDOW_US) return;
+
+    // Publish statistics and start new window
+    profiler_stats_t stats = {
+        .n_blocks           = window.n_blocks,
+        .cycles_min         = window.cycles_min,
+        .cycles_avg         = (uint32_t) (window.cycles_sum / window.n_blocks),
+        .cycles_max         = window.cycles_max,
+        .synth_cycles_avg   = (uint32_t) (window.synth_cycles_sum / window.n_blocks),
+        .effects_cycles_avg = (uint32_t) (window.effects_cycles_sum / window.n_blocks),
+        .load_min           = window.load_min,
+        .load_avg           = 100.0f * window.cycles_sum / window.period_cycles_sum,
+        .load_max           = window.load_max,
+        .latency_avg_us     = (uint32_t) (window.latency_sum_us / window.n_blocks),
+        .latency_max_us     = window.latency_max_us,
+        .deadline_misses    = window.deadline_misses,
+    };
+
+    taskENTER_CRITICAL(&profiler_mux);
+    profiler_stats = stats;
+    taskEXIT_CRITICAL(&profiler_mux);
+
+    uint32_t deadline_misses = window.deadline_misses;
+    memset(&window, 0, sizeof(window));
+    window.window_start_us = now_us;
+    window.deadline_misses = deadline_misses;
+    window.load_last       = load;
+}
+
+/**
+ * Load of the last block.
+ */
+float IRAM_ATTR profiler_get_block_load() {
+    return window.load_last;
+}
+#endif
+
+#if CONFIG_PROFILER_ENABLE && CONFIG_PROFILER_LOG_INTERVAL > 0
+/**
+ * Background task to log the statistics periodically.
+ */
+static void profiler_task(void* parameters) {
+    while (true) {
+        vTaskDelay(CONFIG_PROFILER_LOG_INTERVAL * 1000 / portTICK_PERIOD_MS);
+
+        profiler_stats_t stats;
+        profiler_get_stats(&stats);
+
+        ESP_LOGI(TAG,
+            "DSP load %.1f/%.1f/%.1f%% (min/avg/max), %" PRIu32 "/%" PRIu32 "/%" PRIu32 " cycles per block, "
+            "synth %" PRIu32 " cycles, effects %" PRIu32 " cycles, ISR latency %" PRIu32 "/%" PRIu32 " us (avg/max), %" PRIu32 " late, %" PRIu32 " dropped",
+            stats.load_min, stats.load_avg, stats.load_max,
+            stats.cycles_min, stats.cycles_avg, stats.cycles_max,
+            stats.synth_cycles_avg, stats.effects_cycles_avg, stats.latency_avg_us, stats.latency_max_us,
+            stats.deadline_misses, stats.overruns
+        );
+    }
+}
+#endif
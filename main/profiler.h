@@ -0,0 +1,122 @@
+/*
+ * Klimper: ESP32 I²S Synthesizer Test
+ * © 2024 Dennis Schulmeister-Zimolong <dennis@wpvs.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ */
+
+#pragma once
+
+#include <stddef.h>                         // size_t
+#include <stdint.h>                         // int64_t, uint32_t
+#include "sdkconfig.h"                      // CONFIG_PROFILER_ENABLE
+
+/**
+ * Configuration parameters for the DSP profiler.
+ */
+typedef struct {
+    int    sample_rate;                     // Sample rate in Hz
+    size_t n_buffers;                       // Number of DMA buffers (to detect deadline misses)
+} profiler_config_t;
+
+/**
+ * DSP load statistics of the last measurement window (one second). Cycle counts are
+ * given per DMA buffer (block), the load in percent of the time that the audio
+ * hardware needs to play one block.
+ */
+typedef struct {
+    uint32_t n_blocks;                      // Number of blocks in the measurement window
+    uint32_t cycles_min;                    // Minimum CPU cycles per block
+    uint32_t cycles_avg;                    // Average CPU cycles per block
+    uint32_t cycles_max;                    // Maximum CPU cycles per block
+    uint32_t synth_cycles_avg;              // Average CPU cycles per block spent in `synth_process()`
+    uint32_t effects_cycles_avg;            // Average CPU cycles per block spent in the effects
+    float    load_min;                      // Minimum DSP load in percent
+    float    load_avg;                      // Average DSP load in percent
+    float    load_max;                      // Maximum DSP load in percent
+    uint32_t latency_avg_us;                // Average wake-up latency from the I²S ISR to the DSP task
+    uint32_t latency_max_us;                // Maximum wake-up latency from the I²S ISR to the DSP task
+    uint32_t deadline_misses;               // Blocks finished too late since startup
+    uint32_t overruns;                      // DMA buffers dropped by the ISR since startup
+} profiler_stats_t;
+
+/**
+ * Initialize the profiler and start a low-priority task on core 0, that logs the
+ * statistics every `CONFIG_PROFILER_LOG_INTERVAL` seconds.
+ *
+ * @param config Configuration parameters (can be freed afterwards)
+ */
+void profiler_init(profiler_config_t* config);
+
+/**
+ * Get statistics of the last completed measurement window.
+ *
+ * @param stats [out] Statistics
+ */
+void profiler_get_stats(profiler_stats_t* stats);
+
+/**
+ * Format the statistics as two short lines of text for the 16x2 LCD display.
+ *
+ * @param line1 [out] First line (at least 17 characters)
+ * @param line2 [out] Second line (at least 17 characters)
+ */
+void profiler_format_lcd(char* line1, char* line2);
+
+#if CONFIG_PROFILER_ENABLE
+/**
+ * Start measuring a new block. Must be called by the DSP task right after it received
+ * a new DMA buffer.
+ *
+ * @param queued_us System time when the ISR queued the DMA buffer
+ */
+void profiler_begin_block(int64_t queued_us);
+
+/**
+ * Start measuring the time spent in `synth_process()` within the current block.
+ */
+void profiler_begin_synth();
+
+/**
+ * Stop measuring the time spent in `synth_process()`. May be called more than once
+ * per block, with the times added up.
+ */
+void profiler_end_synth();
+
+/**
+ * Start measuring the time spent in the effects after the synthesizer within the current block.
+ */
+void profiler_begin_effects();
+
+/**
+ * Stop measuring the time spent in the effects. May be called more than once per block,
+ * with the times added up.
+ */
+void profiler_end_effects();
+
+/**
+ * Finish measuring the current block and update the statistics.
+ *
+ * @param n_samples Number of samples in the block (two per stereo frame)
+ */
+void profiler_end_block(size_t n_samples);
+
+/**
+ * Get the DSP load of the last finished block. Unlike the statistics, this is meant
+ * for the DSP task itself, e.g. to adapt the processing to the load.
+ *
+ * @returns DSP load in percent
+ */
+float profiler_get_block_load();
+#else
+static inline void profiler_begin_block(int64_t queued_us) {}
+static inline void profiler_begin_synth() {}
+static inline void profiler_end_synth() {}
+static inline void profiler_begin_effects() {}
+static inline void profiler_end_effects() {}
+static inline void profiler_end_block(size_t n_samples) {}
+static inline float profiler_get_block_load() { return 0.0f; }
+#endif
@@ -0,0 +1,191 @@
+/*
+ * Klimper: ESP32 I²S Synthesizer Test
+ * © 2024 Dennis Schulmeister-Zimolong <dennis@wpvs.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ */
+
+#include "render.h"
+
+#include <esp_log.h>                        // ESP_LOGx
+#include <stdlib.h>                         // calloc(), free()
+#include "dsp/mix.h"                        // dsp_mix_xyz
+#include "profiler.h"                       // profiler_xyz
+#include "trace.h"                          // trace_record()
+
+static const char* TAG = "render";          // Logging tag
+
+/**
+ * Create a new processing cycle instance.
+ */
+render_t* render_new(render_config_t* config) {
+    ESP_LOGD(TAG, "Creating new processing cycle instance");
+
+    render_t* render = calloc(1, sizeof(render_t));
+    render->params.synth            = config->synth;
+    render->params.sequencer        = config->sequencer;
+    render->params.delay            = config->delay;
+    render->params.ui_events        = config->ui_events;
+    render->params.sequencer_events = config->sequencer_events;
+    render->params.midi_events      = config->midi_events;
+
+    atomic_init(&render->state.midi_volume, -1.0f);
+
+    ESP_LOGI(TAG, "Created processing cycle instance %p", render);
+
+    return render;
+}
+
+/**
+ * Delete a processing cycle instance.
+ */
+void render_free(render_t* render) {
+    ESP_LOGD(TAG, "Freeing processing cycle instance %p", render);
+    free(render);
+}
+
+/**
+ * Pass all events of the given queue that are due at the given offset of the current
+ * processing cycle on to the synthesizer or sequencer. Called while the cycle is rendered,
+ * so that the synthesizer and sequencer are only ever changed by the DSP task itself.
+ * Events due later in the cycle stay in the queue and their offset is returned, so that
+ * the rendering can be split there. The offset is rounded up to the next stereo frame.
+ *
+ * @param render Processing cycle instance
+ * @param queue Event queue or NULL
+ * @param offset Current sample offset within the processing cycle
+ * @param next Offset where the rendering is split anyway (e.g. end of the cycle)
+ * @returns Offset of the next pending event, if it is before `next`, otherwise `next`
+ */
+static size_t render_handle_events(render_t* render, event_queue_t* queue, size_t offset, size_t next) {
+    if (!queue) return next;
+
+    synth_t*       synth     = render->params.synth;
+    sequencer_t*   sequencer = render->params.sequencer;
+    const event_t* event;
+
+    while ((event = event_queue_peek(queue))) {
+        int32_t due = (int32_t) (event->time - render->state.clock);
+
+        if (event->time != EVENT_NOW && due > (int32_t) offset) {
+            size_t due_frame = (due + 1) & ~1;
+            return due_frame < next ? due_frame : next;
+        }
+
+        switch (event->type) {
+            case EVENT_NOTE_ON:
+                synth_note_on(synth, event->note, event->value);
+                break;
+
+            case EVENT_NOTE_OFF:
+                synth_note_off(synth, event->note);
+                break;
+
+            case EVENT_SYNTH_VOLUME:
+                synth_set_volume(synth, event->value);
+
+                // Keep the UI in sync with MIDI
+                if (queue == render->params.midi_events) {
+                    atomic_store_explicit(&render->state.midi_volume, event->value, memory_order_relaxed);
+                }
+                break;
+
+            case EVENT_SEQUENCER_BPM:
+                sequencer_set_bpm(sequencer, event->value);
+                break;
+
+            case EVENT_SEQUENCER_RUNNING:
+                sequencer_set_running(sequencer, event->value != 0.0f);
+                break;
+
+            case EVENT_SEQUENCER_TOGGLE:
+                // Resolved here, since MIDI start/stop changes the play state, too
+                sequencer_set_running(sequencer, !sequencer->params.running);
+                break;
+        }
+
+        event_t handled;
+        event_queue_pop(queue, &handled);
+    }
+
+    return next;
+}
+
+#if CONFIG_DSP_IDLE_SKIP
+/**
+ * Check whether the cycle would only render silence: The sequencer is stopped, no voice
+ * is sounding, the delay tail has died away and no event is waiting in any queue. Called
+ * after the events due at the beginning of the cycle have been handled.
+ */
+static bool render_is_silent(render_t* render) {
+    return !render->params.sequencer->params.running
+        && render->params.synth->state.n_active == 0
+        && (!render->params.delay || dsp_delay_is_silent(render->params.delay))
+        && !(render->params.ui_events   && event_queue_peek(render->params.ui_events))
+        && !event_queue_peek(render->params.sequencer_events)
+        && !(render->params.midi_events && event_queue_peek(render->params.midi_events));
+}
+#endif
+
+/**
+ * Run one processing cycle. The cycle is rendered piecewise from one event to the next,
+ * so that note events take effect at their exact sample instead of being quantized to
+ * the cycle length.
+ */
+bool render_cycle(render_t* render, audiohw_sample_t* output, size_t n) {
+#if CONFIG_AUDIO_I2S_32BIT
+    // 32-bit slots have the same size as the DSP samples: Render straight into the
+    // output buffer and convert in place, so that no extra buffer and copy is needed.
+    dsp_sample_t* buffer = (dsp_sample_t*) output;
+#else
+    dsp_sample_t* buffer = render->state.buffer;
+#endif
+
+    render_handle_events(render, render->params.midi_events, 0, n);
+    render_handle_events(render, render->params.ui_events, 0, n);
+    trace_record(TRACE_SEQUENCER_BEGIN, 0);
+    sequencer_process(render->params.sequencer, n);
+    trace_record(TRACE_SEQUENCER_END, 0);
+
+#if CONFIG_DSP_IDLE_SKIP
+    if (render_is_silent(render)) {
+        synth_skip(render->params.synth, n);
+        render->state.clock += n;
+        return false;
+    }
+#endif
+
+    dsp_mix_clear(buffer, n);
+
+    for (size_t done = 0; done < n;) {
+        size_t next = n;
+        next = render_handle_events(render, render->params.ui_events, done, next);
+        next = render_handle_events(render, render->params.sequencer_events, done, next);
+        next = render_handle_events(render, render->params.midi_events, done, next);
+
+        profiler_begin_synth();
+        synth_process(render->params.synth, buffer + done, next - done);
+        profiler_end_synth();
+
+        done = next;
+    }
+
+    render->state.clock += n;
+
+    if (render->params.delay) {
+        profiler_begin_effects();
+        dsp_delay_process(render->params.delay, buffer, n);
+        profiler_end_effects();
+    }
+
+#if CONFIG_AUDIO_I2S_32BIT
+    dsp_mix_to_int32(buffer, n);
+#else
+    dsp_mix_to_int16(buffer, output, n);
+#endif
+
+    return true;
+}
@@ -0,0 +1,88 @@
+/*
+ * Klimper: ESP32 I²S Synthesizer Test
+ * © 2024 Dennis Schulmeister-Zimolong <dennis@wpvs.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ */
+
+#pragma once
+
+#include <stdatomic.h>                      // _Atomic
+#include <stdbool.h>                        // bool, true, false
+#include <stddef.h>                         // size_t
+#include <stdint.h>                         // uint32_t
+#include "sdkconfig.h"                      // CONFIG_AUDIO_N_SAMPLES_CYCLE
+#include "driver/audiohw.h"                 // audiohw_sample_t
+#include "dsp/delay.h"                      // dsp_delay_t
+#include "dsp/sample.h"                     // dsp_sample_t
+#include "event.h"                          // event_queue_t
+#include "sequencer.h"                      // sequencer_t
+#include "synth.h"                          // synth_t
+
+/**
+ * One processing cycle of the DSP task: Pass the control events on to the synthesizer
+ * and sequencer, render the voices piecewise from one event to the next, apply the
+ * effects and convert the mix to the sample format of the I²S slots. The DSP task and
+ * the offline render of the benchmarks share this, so that the render checksum covers
+ * the same code path as the firmware.
+ */
+typedef struct {
+    struct {
+        synth_t*       synth;               // Synthesizer (not freed)
+        sequencer_t*   sequencer;           // Sequencer (not freed)
+        dsp_delay_t*   delay;               // Delay effect or NULL (not freed)
+        event_queue_t* ui_events;           // UI events or NULL (not freed)
+        event_queue_t* sequencer_events;    // Sequencer events (not freed)
+        event_queue_t* midi_events;         // MIDI events or NULL (not freed)
+    } params;
+
+    struct {
+        uint32_t      clock;                // Number of samples rendered so far (event time stamps)
+        _Atomic float midi_volume;          // MIDI volume not yet picked up by the UI, negative if none
+#if !CONFIG_AUDIO_I2S_32BIT
+        dsp_sample_t  buffer[CONFIG_AUDIO_N_SAMPLES_CYCLE];  // Mix of one cycle before the conversion
+#endif
+    } state;
+} render_t;
+
+/**
+ * Configuration parameters for the processing cycle.
+ */
+typedef struct {
+    synth_t*       synth;                   // Synthesizer (not freed by `render_free()`)
+    sequencer_t*   sequencer;               // Sequencer (not freed by `render_free()`)
+    dsp_delay_t*   delay;                   // Delay effect or NULL (not freed by `render_free()`)
+    event_queue_t* ui_events;               // UI events or NULL (not freed by `render_free()`)
+    event_queue_t* sequencer_events;        // Sequencer events (not freed by `render_free()`)
+    event_queue_t* midi_events;             // MIDI events or NULL (not freed by `render_free()`)
+} render_config_t;
+
+/**
+ * Create a new processing cycle instance.
+ *
+ * @param config Configuration parameters (can be freed afterwards)
+ * @returns Pointer to the processing cycle instance
+ */
+render_t* render_new(render_config_t* config);
+
+/**
+ * Delete a processing cycle instance as a replacement for `free()`.
+ *
+ * @param render Processing cycle instance
+ */
+void render_free(render_t* render);
+
+/**
+ * Run one processing cycle. With `CONFIG_DSP_IDLE_SKIP` a cycle that would only render
+ * silence is skipped: The clocks are advanced, but the output is left unchanged and
+ * must be cleared by the caller where needed.
+ *
+ * @param render Processing cycle instance
+ * @param output Output samples in the format of the I²S slots
+ * @param n Number of samples (two per stereo frame, at most `CONFIG_AUDIO_N_SAMPLES_CYCLE`)
+ * @returns `false` if the cycle has been skipped because of silence
+ */
+bool render_cycle(render_t* render, audiohw_sample_t* output, size_t n);
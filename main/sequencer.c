@@ -11,7 +11,10 @@
 #include "sequencer.h"
 
 #include <esp_log.h>                                    // ESP_LOGx
+#include <stdlib.h>                                     // calloc(), malloc(), free(), rand()
 #include <string.h>                                     // memcpy()
+#include "sdkconfig.h"                                  // CONFIG_AUDIO_SAMPLE_RATE
+#include "dsp/utils.h"                                  // xorshift32()
 
 static const char* TAG = "sequencer";                   // Logging tag
 
@@ -23,12 +26,14 @@ sequencer_t* sequencer_new(sequencer_config_t* config) {
 
     sequencer_t* sequencer = calloc(1, sizeof(sequencer_t));
 
-    sequencer->params.synth = config->synth;
+    sequencer->params.events = config->events;
 
     sequencer->notes_available.midi_notes = malloc(config->n_notes * sizeof(int));
     sequencer->notes_available.length     = config->n_notes;
     memcpy(sequencer->notes_available.midi_notes, config->notes, config->n_notes * sizeof(int));
 
+    sequencer->state.random = config->seed ? config->seed : (uint32_t) rand() | 1;
+
     ESP_LOGI(TAG, "Created sequencer instance %p", sequencer);
 
     return sequencer;
@@ -71,46 +76,71 @@ void sequencer_set_running(sequencer_t* sequencer, bool running) {
 }
 
 /**
- * Run the sequencer for another processing block.
+ * Run the sequencer for another processing block. Steps from one note-on or note-off
+ * to the next within the block, so that each event is stamped with its exact sample.
  */
 void sequencer_process(sequencer_t* sequencer, size_t n_samples_passed) {
-    // Trigger note-off events
-    for (int i = 0; i < SEQUENCER_POLYPHONY; i++) {
-        if (sequencer->state.notes_playing[i].samples_remaining <= 0) continue;
-        sequencer->state.notes_playing[i].samples_remaining -= n_samples_passed;
-
-        if (sequencer->state.notes_playing[i].samples_remaining <= 0) {
-            ESP_LOGD(TAG, "Triggering note-off for note %i", sequencer->state.notes_playing[i].note);
-            synth_note_off(sequencer->params.synth, sequencer->state.notes_playing[i].note);
+    int offset = 0;
+
+    while (true) {
+        // Samples until the next note-off or note-on, but not beyond the end of the block
+        int step = (int) n_samples_passed - offset;
+
+        for (int i = 0; i < SEQUENCER_POLYPHONY; i++) {
+            int remaining = sequencer->state.notes_playing[i].samples_remaining;
+            if (remaining > 0 && remaining < step) step = remaining;
+        }
+
+        if (sequencer->params.running && sequencer->state.pause_remaining < step) {
+            step = sequencer->state.pause_remaining > 0 ? sequencer->state.pause_remaining : 0;
         }
-    }
 
-    // Pause sequencer between notes
-    if (!sequencer->params.running) return;
+        offset += step;
+        uint32_t time = sequencer->state.clock + offset;
 
-    sequencer->state.pause_remaining -= n_samples_passed;
-    if (sequencer->state.pause_remaining > 0) return;      // Signed int to avoid edge case at first call
+        // Trigger note-off events
+        for (int i = 0; i < SEQUENCER_POLYPHONY; i++) {
+            if (sequencer->state.notes_playing[i].samples_remaining <= 0) continue;
+            sequencer->state.notes_playing[i].samples_remaining -= step;
 
-    sequencer_duration_t pause_duration = rand() % SEQUENCER_DURATION_MAX;
-    sequencer->state.pause_remaining = sequencer->state.durations[pause_duration];
+            if (sequencer->state.notes_playing[i].samples_remaining <= 0) {
+                ESP_LOGD(TAG, "Triggering note-off for note %i", sequencer->state.notes_playing[i].note);
+                event_queue_send(sequencer->params.events, time, EVENT_NOTE_OFF, sequencer->state.notes_playing[i].note, 0.0f);
+            }
+        }
+
+        // Pause sequencer between notes. The end of the block is checked after the note-off
+        // events, because they may be due exactly at the end. A note-on at the very end of
+        // the block is triggered with the next block instead, which makes no difference.
+        if (sequencer->params.running) sequencer->state.pause_remaining -= step;
+
+        if (offset >= (int) n_samples_passed) break;
+        if (!sequencer->params.running) continue;
+        if (sequencer->state.pause_remaining > 0) continue;    // Signed int to avoid edge case at first call
 
-    ESP_LOGD(TAG, "Pause is over. New pause duration: %i samples", sequencer->state.pause_remaining);
+        sequencer_duration_t pause_duration = xorshift32(&sequencer->state.random) % SEQUENCER_DURATION_MAX;
+        sequencer->state.pause_remaining = sequencer->state.durations[pause_duration];
 
-    // Play new note
-    for (int i = 0; i < SEQUENCER_POLYPHONY; i++) {
-        if (sequencer->state.notes_playing[i].samples_remaining > 0) continue;
+        ESP_LOGD(TAG, "Pause is over. New pause duration: %i samples", sequencer->state.pause_remaining);
 
-        int note_index = rand() % sequencer->notes_available.length;
-        sequencer_duration_t note_duration = rand() % SEQUENCER_DURATION_MAX;
-        float velocity = rand() % 256 / 255.0f;
+        // Play new note
+        for (int i = 0; i < SEQUENCER_POLYPHONY; i++) {
+            if (sequencer->state.notes_playing[i].samples_remaining > 0) continue;
 
-        sequencer->state.notes_playing[i].note = sequencer->notes_available.midi_notes[note_index];
-        sequencer->state.notes_playing[i].samples_remaining = sequencer->state.durations[note_duration];
+            int note_index = xorshift32(&sequencer->state.random) % sequencer->notes_available.length;
+            sequencer_duration_t note_duration = xorshift32(&sequencer->state.random) % SEQUENCER_DURATION_MAX;
+            float velocity = (xorshift32(&sequencer->state.random) >> 24) / 255.0f;
 
-        ESP_LOGD(TAG, "Triggering note-on for note %i with velocity %f and duration %i samples",
-                sequencer->state.notes_playing[i].note, velocity, sequencer->state.notes_playing[i].samples_remaining);
+            sequencer->state.notes_playing[i].note = sequencer->notes_available.midi_notes[note_index];
+            sequencer->state.notes_playing[i].samples_remaining = sequencer->state.durations[note_duration];
 
-        synth_note_on(sequencer->params.synth, sequencer->state.notes_playing[i].note, velocity);
-        break;
+            ESP_LOGD(TAG, "Triggering note-on for note %i with velocity %f and duration %i samples",
+                    sequencer->state.notes_playing[i].note, velocity, sequencer->state.notes_playing[i].samples_remaining);
+
+            event_queue_send(sequencer->params.events, time, EVENT_NOTE_ON, sequencer->state.notes_playing[i].note, velocity);
+            break;
+        }
     }
+
+    sequencer->state.clock += n_samples_passed;
 }
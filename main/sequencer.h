@@ -12,7 +12,8 @@
 
 #include <stddef.h>                         // size_t
 #include <stdbool.h>                        // bool, true, false
-#include "synth.h"
+#include <stdint.h>                         // uint32_t
+#include "event.h"                          // event_xyz
 
 #define SEQUENCER_POLYPHONY (8)             // Worst-case: Four 16th-notes, 1/4 long = 4 notes
 
@@ -36,14 +37,15 @@ typedef struct {
 } sequencer_note_t;
 
 /**
- * A simple sequencer that triggers random notes from a given scale
- * on the synthesizer.
+ * A simple sequencer that triggers random notes from a given scale. The notes are
+ * sent as time-stamped events to the sequencer's event queue, from where the DSP
+ * task passes them on to the synthesizer.
  */
 typedef struct {
-    volatile struct {
-        synth_t* synth;                     // The controlled synthesizer (not freed)
-        float    bpm;                       // Tempo in beats per minute
-        bool     running;                   // Play state (playing or stopped)
+    struct {
+        event_queue_t* events;              // Event queue for the triggered notes (not freed)
+        float          bpm;                 // Tempo in beats per minute
+        bool           running;             // Play state (playing or stopped)
     } params;
 
     struct {
@@ -54,6 +56,8 @@ typedef struct {
     struct {
         int durations[3];                   // Sample durations for quarter/eighth/sixteenth notes
         int pause_remaining;                // Number of samples until the next note is triggered
+        uint32_t clock;                     // Number of samples processed so far (event time stamps)
+        uint32_t random;                    // Random generator state for the notes and pauses
 
         sequencer_note_t notes_playing[SEQUENCER_POLYPHONY];    // Currently played notes
     } state;                                // Internal sequencer state
@@ -63,9 +67,10 @@ typedef struct {
  * Configuration parameters for the sequencer.
  */
 typedef struct {
-    synth_t* synth;                         // The controlled synthesizer (not freed by `sequencer_free()`)
-    int*     notes;                         // Array with available MIDI notes (will be copied)
-    size_t   n_notes;                       // Number of available MIDI notes
+    event_queue_t* events;                  // Event queue for the triggered notes (not freed by `sequencer_free()`)
+    int*           notes;                   // Array with available MIDI notes (will be copied)
+    size_t         n_notes;                 // Number of available MIDI notes
+    uint32_t       seed;                    // Seed of the random notes (0 for a seed from `rand()`)
 } sequencer_config_t;
 
 /**
@@ -85,7 +90,8 @@ sequencer_t* sequencer_new(sequencer_config_t* config);
 void sequencer_free(sequencer_t* sequencer);
 
 /**
- * Change the musical tempo of the sequencer.
+ * Change the musical tempo of the sequencer. Must not be called concurrently with
+ * `sequencer_process()`.
  *
  * @param sequencer Sequencer instance
  * @param bpm New beats-per-minute
@@ -93,7 +99,8 @@ void sequencer_free(sequencer_t* sequencer);
 void sequencer_set_bpm(sequencer_t* sequencer, int bpm);
 
 /**
- * Set play state to start or stop the sequencer.
+ * Set play state to start or stop the sequencer. Must not be called concurrently
+ * with `sequencer_process()`.
  *
  * @param sequencer Sequencer instance
  * @param running Play state
@@ -102,8 +109,9 @@ void sequencer_set_running(sequencer_t* sequencer, bool running);
 
 /**
  * Run the sequencer to create new events based on the time passed since the last call.
- * This "plays" the synthesizer and updates its parameters. Passed time is calculated
- * based on the given number of samples rendered since the last call.
+ * This "plays" the synthesizer by sending note events to the event queue. Passed time
+ * is calculated based on the given number of samples rendered since the last call.
+ * Must be called by the producer task of the event queue.
  *
  * @param sequencer Sequencer instance
  * @param n_samples_pass Number of samples rendered since the last call
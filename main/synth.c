@@ -10,51 +10,148 @@
 
 #include "synth.h"
 
+#include <assert.h>                         // assert()
 #include <esp_log.h>                        // ESP_LOGx
 #include <esp_attr.h>                       // IRAM_ATTR
+#include <esp_heap_caps.h>                  // heap_caps_aligned_calloc(), heap_caps_free()
 #include <float.h>                          // FLT_MAX
-#include <stdlib.h>                         // calloc(), malloc(), free()
+#include <stdlib.h>                         // calloc(), malloc(), free(), rand()
 #include <string.h>                         // memcpy()
 #include <math.h>                           // cos()
+#include "dsp/mix.h"                        // dsp_mix_add(), dsp_mix_clear()
 #include "dsp/pan.h"                        // dsp_pan()
-#include "dsp/utils.h"                      // mtof()
+#include "dsp/utils.h"                      // mtof(), xorshift32()
+#include "trace.h"                          // trace_record()
 
 static const char* TAG = "synth";           // Logging tag
 
+#if CONFIG_SYNTH_DUAL_CORE
+static void synth_worker_task(void* parameters);
+#endif
+
+static void synth_apply_params(synth_t* synth);
+
+// Include FM algorithms and configured voice kernel
+#include "synth/algorithms.h"
+
+#if CONFIG_DSP_ENGINE_FIXED
+    #include "synth/fixed.c"
+#elif CONFIG_DSP_ENGINE_LOG
+    #include "synth/logexp.c"
+#else
+    #include "synth/float.c"
+#endif
+
+/**
+ * Clamp an algorithm number to the available algorithms.
+ */
+static inline int synth_clamp_algorithm(int algorithm) {
+    if (algorithm < 0) return 0;
+    if (algorithm >= SYNTH_N_ALGORITHMS) return SYNTH_N_ALGORITHMS - 1;
+    return algorithm;
+}
+
 /**
  * Create new synthesizer instance.
  */
 synth_t* synth_new(synth_config_t* config) {
     ESP_LOGD(TAG, "Creating new synthesizer instance");
 
+#if CONFIG_DSP_ENGINE_LOG
+    assert(config->fm.index_max <= DSP_OSCIL_LOG_FM_INDEX_MAX);
+#endif
+
     synth_t* synth = calloc(1, sizeof(synth_t));
 
     synth->params.volume    = config->volume;
+    synth->params.env1      = config->env1;
+    synth->params.env2      = config->env2;
     synth->params.fm        = config->fm;
+    synth->params.algorithm = synth_clamp_algorithm(config->algorithm);
 
     synth->params.fm.ratios = malloc(config->fm.n_ratios * sizeof(float));
     memcpy(synth->params.fm.ratios, config->fm.ratios, config->fm.n_ratios * sizeof(float));
 
     synth->state.gain_staging = 1.0f / CONFIG_SYNTH_POLYPHONY;
-    synth->state.voices       = calloc(CONFIG_SYNTH_POLYPHONY, sizeof(synth_voice_t));
+    synth->state.gain_end     = config->volume * synth->state.gain_staging;
+    synth->state.max_voices   = CONFIG_SYNTH_POLYPHONY;
+
+    dsp_wavetable_t* wavetable = synth_voice_wavetable(config);
+
+#if CONFIG_SYNTH_VOICE_POOL
+    synth_voice_pool_t* pool = heap_caps_aligned_calloc(4, 1, sizeof(synth_voice_pool_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    synth->state.pool   = pool;
+    synth->state.voices = pool->voices;
+
+    for (int i = 0; i < CONFIG_SYNTH_POLYPHONY; i++) {
+        synth->state.voices[i].osc  = pool->osc[i];
+        synth->state.voices[i].env  = pool->env[i];
+        synth->state.voices[i].lfo1 = &pool->lfo1[i];
+
+        dsp_oscil_init(synth->state.voices[i].lfo1, wavetable);
+    }
+#else
+    synth->state.voices = calloc(CONFIG_SYNTH_POLYPHONY, sizeof(synth_voice_t));
 
     for (int i = 0; i < CONFIG_SYNTH_POLYPHONY; i++) {
-        synth->state.voices[i].osc1 = dsp_oscil_new(config->wavetable);
-        synth->state.voices[i].env1 = dsp_adsr_new();
-        synth->state.voices[i].lfo1 = dsp_oscil_new(config->wavetable);
+        synth->state.voices[i].osc  = malloc(SYNTH_N_OPERATORS * sizeof(dsp_oscil_t));
+        synth->state.voices[i].env  = malloc(SYNTH_N_OPERATORS * sizeof(dsp_adsr_t));
+        synth->state.voices[i].lfo1 = dsp_oscil_new(wavetable);
+    }
+#endif
+
+    for (int i = 0; i < CONFIG_SYNTH_POLYPHONY; i++) {
+        for (int op = 0; op < SYNTH_N_OPERATORS; op++) {
+            dsp_oscil_init(&synth->state.voices[i].osc[op], wavetable);
+            dsp_adsr_init(&synth->state.voices[i].env[op]);
+        }
+    }
 
-        synth->state.voices[i].osc2 = dsp_oscil_new(config->wavetable);
-        synth->state.voices[i].env2 = dsp_adsr_new();
+    synth->state.random = config->seed ? config->seed : (uint32_t) rand() | 1;
 
-        float lfo_freq = rand() % 256 / 255.0f * 3.0f + 0.33f;
+    for (int i = 0; i < CONFIG_SYNTH_POLYPHONY; i++) {
+        float lfo_freq = (xorshift32(&synth->state.random) >> 24) / 255.0f * 3.0f + 0.33f;
         dsp_oscil_reinit(synth->state.voices[i].lfo1, lfo_freq, true);
     }
 
-    synth_set_env1_values(synth, config->env1);
-    synth_set_env2_values(synth, config->env2);
+    // Pitch tables, so that a note-on needs no pow() and divisions. All operators use the same wavetable.
+    int n_ratios = synth->params.fm.n_ratios;
+
+    synth->state.allocator = allocator_new(CONFIG_SYNTH_POLYPHONY);
+    synth->state.pitch1    = malloc(ALLOCATOR_N_NOTES * sizeof(dsp_oscil_pitch_t));
+    synth->state.pitch2    = malloc(ALLOCATOR_N_NOTES * n_ratios * sizeof(dsp_oscil_pitch_t));
+
+    for (int note = 0; note < ALLOCATOR_N_NOTES; note++) {
+        float freq1 = mtof(note);
+        dsp_oscil_get_pitch(synth->state.voices[0].osc, freq1, &synth->state.pitch1[note]);
+
+        for (int i = 0; i < n_ratios; i++) {
+            float freq2 = freq1 * synth->params.fm.ratios[i];
+            dsp_oscil_get_pitch(synth->state.voices[0].osc, freq2, &synth->state.pitch2[note * n_ratios + i]);
+        }
+    }
+
+    synth_apply_params(synth);
 
     dsp_pan_init();
 
+#if CONFIG_SYNTH_DUAL_CORE
+    // Worker task on core 0 for the second half of the voices. The DSP task calling
+    // `synth_process()` is expected to run on core 1 with the same priority.
+    synth->worker.buffer = calloc(CONFIG_AUDIO_N_SAMPLES_CYCLE, sizeof(dsp_sample_t));
+    synth->worker.done   = xSemaphoreCreateBinary();
+
+    xTaskCreatePinnedToCore(
+        /* pvTaskCode    */ synth_worker_task,
+        /* pcName        */ "synth_worker",
+        /* uxStackDepth  */ 5120,
+        /* pvParameters  */ synth,
+        /* uxPriority    */ configMAX_PRIORITIES - 1,
+        /* pxCreatedTask */ &synth->worker.task,
+        /* xCoreID       */ 0
+    );
+#endif
+
     ESP_LOGI(TAG, "Created synthesizer instance %p with %i voices polyphony", synth, CONFIG_SYNTH_POLYPHONY);
 
     return synth;
@@ -66,17 +163,29 @@ synth_t* synth_new(synth_config_t* config) {
 void synth_free(synth_t* synth) {
     ESP_LOGD(TAG, "Freeing synthesizer instance %p", synth);
 
+#if CONFIG_SYNTH_DUAL_CORE
+    vTaskDelete(synth->worker.task);
+    vSemaphoreDelete(synth->worker.done);
+    free(synth->worker.buffer);
+#endif
+
+    allocator_free(synth->state.allocator);
+    free(synth->state.pitch1);
+    free(synth->state.pitch2);
+
+    free(synth->params.fm.ratios);
+
+#if CONFIG_SYNTH_VOICE_POOL
+    heap_caps_free(synth->state.pool);
+#else
     for (int i = 0; i < CONFIG_SYNTH_POLYPHONY; i++) {
-        dsp_oscil_free(synth->state.voices[i].osc1);
-        dsp_adsr_free(synth->state.voices[i].env1);
+        free(synth->state.voices[i].osc);
+        free(synth->state.voices[i].env);
         dsp_oscil_free(synth->state.voices[i].lfo1);
-
-        dsp_oscil_free(synth->state.voices[i].osc2);
-        dsp_adsr_free(synth->state.voices[i].env2);
     }
 
-    free(synth->params.fm.ratios);
     free(synth->state.voices);
+#endif
     free(synth);
 }
 
@@ -86,120 +195,300 @@ void synth_free(synth_t* synth) {
 void synth_set_volume(synth_t* synth, float volume)  {
     ESP_LOGD(TAG, "Set volume to %f", volume);
 
-    synth->params.volume = volume;
+    synth->params.volume  = volume;
+    synth->params_changed = true;
 }
 
 /**
- * Set parameters of the carrier amplitude envelope generator.
+ * Set parameters of the carrier amplitude envelope generators.
  */
 void synth_set_env1_values(synth_t* synth, dsp_adsr_values_t env1) {
-    synth->params.env1 = env1;
-
-    for (int i = 0; i < CONFIG_SYNTH_POLYPHONY; i++) {
-        dsp_adsr_set_values(synth->state.voices[i].env1, &env1);
-    }
+    synth->params.env1    = env1;
+    synth->params_changed = true;
 }
 
 /**
- * Set parameters of the modulator amplitude envelope generator.
+ * Set parameters of the modulator amplitude envelope generators.
  */
 void synth_set_env2_values(synth_t* synth, dsp_adsr_values_t env2) {
-    synth->params.env2 = env2;
+    synth->params.env2    = env2;
+    synth->params_changed = true;
+}
 
-    for (int i = 0; i < CONFIG_SYNTH_POLYPHONY; i++) {
-        dsp_adsr_set_values(synth->state.voices[i].env2, &env2);
+/**
+ * Select FM algorithm.
+ */
+void synth_set_algorithm(synth_t* synth, int algorithm) {
+    ESP_LOGD(TAG, "Set algorithm to %i", algorithm);
+
+    synth->params.algorithm = synth_clamp_algorithm(algorithm);
+    synth->params_changed   = true;
+}
+
+/**
+ * Copy the pending parameters into the snapshot of the DSP task and hand the envelope
+ * values over to the envelope generators, which only need to be updated when they
+ * actually changed. Carriers get the values of `env1`, modulators those of `env2`,
+ * so a new algorithm updates the envelope generators, too.
+ */
+static void synth_apply_params(synth_t* synth) {
+    synth->params_changed = false;
+
+    synth_params_t previous = synth->state.params;
+    synth->state.params = synth->params;
+
+    bool first     = !synth->state.algorithm;
+    bool algorithm = first || previous.algorithm != synth->state.params.algorithm;
+    bool env1      = first || algorithm || memcmp(&previous.env1, &synth->state.params.env1, sizeof(dsp_adsr_values_t));
+    bool env2      = first || algorithm || memcmp(&previous.env2, &synth->state.params.env2, sizeof(dsp_adsr_values_t));
+
+    if (algorithm) {
+        synth->state.algorithm = &synth_algorithms[synth->state.params.algorithm];
+
+        int n_carriers = __builtin_popcount(synth->state.algorithm->carriers);
+        synth->state.carrier_gain     = 1.0f / n_carriers;
+        synth->state.carrier_gain_q12 = 4096 / n_carriers;
+        synth->state.carrier_gain_log = dsp_log_from_float(synth->state.carrier_gain);
+    }
+
+    for (int op = 0; op < SYNTH_N_OPERATORS; op++) {
+        bool carrier = synth->state.algorithm->carriers & (1 << op);
+        if (carrier ? !env1 : !env2) continue;
+
+        for (int i = 0; i < CONFIG_SYNTH_POLYPHONY; i++) {
+            dsp_adsr_set_values(&synth->state.voices[i].env[op], carrier ? &synth->state.params.env1 : &synth->state.params.env2);
+        }
     }
 }
 
 /**
- * Play a new note or re-trigger playing with with same number. Steal the least sounding
- * voice, if the maximum polyphony is exhausted. Once a voice has been allocated simply
- * trigger its envelope generator. The active flag is tied to the envelope generator status
- * in `synth_process()`.
+ * Advance the master gain by `n` frames towards the volume of the parameter snapshot
+ * with a one-pole lowpass, evaluated once per block. The voice kernels ramp linearly
+ * from `gain_start` to `gain_end` within the block.
  */
-void synth_note_on(synth_t* synth, int note, float velocity) {
-    // Voice allocation with re-triggering and voice stealing
-    synth_voice_t* retrigger   = NULL;
-    synth_voice_t* free_voice  = NULL;
-    synth_voice_t* steal_voice = NULL;
-    float          steal_amp   = FLT_MAX;
+static inline void synth_smooth_gain(synth_t* synth, size_t n) {
+    float target = synth->state.params.volume * synth->state.gain_staging;
+    float gain   = synth->state.gain_end;
 
-    for (int i = 0; i < CONFIG_SYNTH_POLYPHONY; i++) {
-        synth_voice_t* voice = &synth->state.voices[i];
-        float          amp   = voice->velocity * voice->env1->state.value;
+    gain += (target - gain) * n / (n + SYNTH_GAIN_SMOOTHING_FRAMES);
+    if (fabsf(target - gain) < 1e-6f) gain = target;
 
-        if (voice->note == note) {
-            retrigger = voice;
+    synth->state.gain_start = synth->state.gain_end;
+    synth->state.gain_end   = gain;
+}
+
+#if CONFIG_SYNTH_GOVERNOR
+/**
+ * Fade out the quietest voices until no more voices are sounding than the polyphony governor
+ * allows. Voices already fading out don't count. The voice with the given index is spared,
+ * since a voice that has just been triggered is still silent, but must be heard.
+ */
+static void synth_shed_voices(synth_t* synth, int keep) {
+    while (true) {
+        synth_voice_t* quietest   = NULL;
+        float          level      = FLT_MAX;
+        int            n_sounding = 0;
+
+        for (int j = 0; j < synth->state.n_active; j++) {
+            synth_voice_t* voice = &synth->state.voices[synth->state.active[j]];
+            if (voice->fade) continue;
+
+            n_sounding++;
+            if (synth->state.active[j] == keep) continue;
+
+            float amp = synth_voice_level(voice);
+
+            if (amp < level) {
+                quietest = voice;
+                level    = amp;
+            }
         }
 
-        if (!voice->active) {
-            free_voice = voice;
-        } else if (amp < steal_amp) {
-            steal_voice = voice;
-            steal_amp   = amp;
+        if (n_sounding <= synth->state.max_voices || !quietest) return;
+
+        ESP_LOGD(TAG, "Shedding voice %i (note %i), limit is %i voices", (int) (quietest - synth->state.voices), quietest->note, synth->state.max_voices);
+        quietest->fade = SYNTH_FADE_FRAMES;
+    }
+}
+
+/**
+ * Adapt the voice limit to the DSP load of the last block.
+ */
+void synth_govern(synth_t* synth, float load) {
+    int n_sounding = 0;
+
+    for (int j = 0; j < synth->state.n_active; j++) {
+        if (!synth->state.voices[synth->state.active[j]].fade) n_sounding++;
+    }
+
+    if (load > CONFIG_SYNTH_GOVERNOR_MAX_LOAD) {
+        // Scale down to the voices that fit, assuming that each voice costs the same
+        int max_voices = (int) (n_sounding * CONFIG_SYNTH_GOVERNOR_MAX_LOAD / load);
+        if (max_voices < CONFIG_SYNTH_GOVERNOR_MIN_VOICES) max_voices = CONFIG_SYNTH_GOVERNOR_MIN_VOICES;
+
+        if (max_voices < synth->state.max_voices) {
+            synth->state.max_voices = max_voices;
+            synth_shed_voices(synth, -1);
+        }
+    } else if (synth->state.max_voices < CONFIG_SYNTH_POLYPHONY && n_sounding >= synth->state.max_voices) {
+        // Allow one more voice, if the limit is reached and the load of one more voice fits
+        if (n_sounding == 0 || load * (n_sounding + 1) / n_sounding <= CONFIG_SYNTH_GOVERNOR_MAX_LOAD) {
+            synth->state.max_voices++;
         }
     }
+}
+#endif
 
-    synth_voice_t* voice = retrigger ? retrigger : free_voice ? free_voice : steal_voice;
+/**
+ * Play a new note or re-trigger playing with with same number. The voice is chosen by the
+ * voice allocator, which re-triggers, takes a free voice or steals the longest released or
+ * longest held voice. Once a voice has been allocated simply trigger its envelope generator.
+ * A free voice is added to the active voice list here, and removed again in `synth_process()`
+ * when its envelope generator has stopped.
+ */
+void synth_note_on(synth_t* synth, int note, float velocity) {
+    if (note < 0 || note >= ALLOCATOR_N_NOTES) return;
+    trace_record(TRACE_NOTE_ON, (uint16_t) note);
+
+    int            index = allocator_note_on(synth->state.allocator, note);
+    synth_voice_t* voice = &synth->state.voices[index];
 
     voice->note = note;
     voice->velocity = velocity;
+    voice->fade = 0;
+
+    // Update FM parameters and trigger the operators. Carriers play the note itself,
+    // modulators a random FM ratio with a random FM index.
+    synth_fm_params* fm = &synth->state.params.fm;
+
+    for (int op = 0; op < SYNTH_N_OPERATORS; op++) {
+        if (synth->state.algorithm->carriers & (1 << op)) {
+            voice->fm_ratio[op]     = 1.0f;
+            voice->fm_index[op]     = 0.0f;
+            voice->fm_index_q12[op] = 0;
+            voice->fm_index_log[op] = DSP_LOG_SILENCE;
+
+            dsp_oscil_set_pitch(&voice->osc[op], &synth->state.pitch1[note]);
+        } else {
+            int   fm_ratio_index = xorshift32(&synth->state.random) % fm->n_ratios;
+            float fm_index       = (xorshift32(&synth->state.random) >> 24) / 255.0f * (fm->index_max - fm->index_min) + fm->index_min;
+            if (fm_index > SYNTH_FM_INDEX_MAX) fm_index = SYNTH_FM_INDEX_MAX;
+
+            voice->fm_ratio[op]     = fm->ratios[fm_ratio_index];
+            voice->fm_index[op]     = fm_index;
+            voice->fm_index_q12[op] = (int32_t) (voice->fm_index[op] * 4096.0f);
+            voice->fm_index_log[op] = dsp_log_from_float(voice->fm_index[op] * DSP_OSCIL_LOG_FM_SCALE);
+
+            dsp_oscil_set_pitch(&voice->osc[op], &synth->state.pitch2[note * fm->n_ratios + fm_ratio_index]);
+        }
 
-    // Update FM parameters
-    int fm_ratio_index = rand() % synth->params.fm.n_ratios;
-    voice->fm_ratio_2_1 = synth->params.fm.ratios[fm_ratio_index];
-    voice->fm_index_2_1 = rand() % 256 / 255.0f * (synth->params.fm.index_max - synth->params.fm.index_min) + synth->params.fm.index_min;
+        dsp_adsr_trigger_attack(&voice->env[op]);
+    }
 
-    // Trigger oscilators and envelope generator
-    float freq1 = mtof(note);
-    float freq2 = freq1 * voice->fm_ratio_2_1;
+    // Activate voice and catch up with the LFO phase it would have had
+    if (!voice->active) {
+        voice->active = true;
+        dsp_oscil_skip(voice->lfo1, synth->state.clock - voice->idle_since);
+        synth_voice_init_pan(voice);
 
-    dsp_oscil_reinit(voice->osc1, freq1, false);
-    dsp_oscil_reinit(voice->osc2, freq2, false);
-    dsp_adsr_trigger_attack(voice->env1);
-    dsp_adsr_trigger_attack(voice->env2);
+        synth->state.active[synth->state.n_active++] = index;
+
+#if CONFIG_SYNTH_GOVERNOR
+        synth_shed_voices(synth, index);
+#endif
+    }
 }
 
 /**
- * Stop a currently playing note. Simply triggers the release part of the envelope generator.
- * The active flag of the corresponding voice will be changed in `synth_process` when the
- * envelope generator has stopped.
+ * Stop a currently playing note. Simply triggers the release part of the envelope generators
+ * of the carriers. The modulators keep sounding until the voice stops. The active flag of the
+ * corresponding voice will be changed in `synth_process` when the envelope generator of
+ * operator 0, which is a carrier in all algorithms, has stopped.
  */
 void synth_note_off(synth_t* synth, int note) {
-    for (int i = 0; i < CONFIG_SYNTH_POLYPHONY; i++) {
-        synth_voice_t* voice = &synth->state.voices[i];
+    if (note < 0 || note >= ALLOCATOR_N_NOTES) return;
+    trace_record(TRACE_NOTE_OFF, (uint16_t) note);
 
-        if (voice->note == note && voice->active) {
-            dsp_adsr_trigger_release(voice->env1);
-        }
+    int index = allocator_note_off(synth->state.allocator, note);
+    if (index == ALLOCATOR_NONE) return;
+
+    for (int op = 0; op < SYNTH_N_OPERATORS; op++) {
+        if (synth->state.algorithm->carriers & (1 << op)) dsp_adsr_trigger_release(&synth->state.voices[index].env[op]);
     }
 }
 
 /**
- * Render next audio block. This calls the different DSP methods to synthesize the sound
- * and updates each voice's active flag based on its envelope generator status.
+ * Render next audio block. This calls the different DSP methods to synthesize the active
+ * voices and afterwards removes the voices whose envelope generator has stopped from the
+ * active voice list. In dual-core mode the worker task renders every second active voice
+ * into its partial buffer, which is then added to the output buffer. The worker buffer
+ * holds one processing cycle, so longer blocks are split into chunks of that size.
  */
-void IRAM_ATTR synth_process(synth_t* synth, float* audio_buffer, size_t length) {
-    // Mix next samples into the output buffer
-    for (size_t i = 0; i < length; i += 2) {
-        for (int j = 0; j < CONFIG_SYNTH_POLYPHONY; j++) {
-            synth_voice_t* voice = &synth->state.voices[j];
+void IRAM_ATTR synth_process(synth_t* synth, dsp_sample_t* audio_buffer, size_t length) {
+    if (synth->params_changed) synth_apply_params(synth);
 
-            float sample2 = dsp_oscil_tick(voice->osc2, 0.0f)    * dsp_adsr_tick(voice->env2) * voice->fm_index_2_1;
-            float sample1 = dsp_oscil_tick(voice->osc1, sample2) * dsp_adsr_tick(voice->env1) * synth->state.gain_staging * synth->params.volume;
+#if CONFIG_SYNTH_DUAL_CORE
+    for (size_t offset = 0; offset < length; offset += CONFIG_AUDIO_N_SAMPLES_CYCLE) {
+        size_t chunk = length - offset;
+        if (chunk > CONFIG_AUDIO_N_SAMPLES_CYCLE) chunk = CONFIG_AUDIO_N_SAMPLES_CYCLE;
 
-            float left, right;
-            float pan = dsp_oscil_tick(voice->lfo1, 0.0f) * 0.75f;
-            dsp_pan_stereo(sample1, pan, &left, &right);
+        synth_smooth_gain(synth, chunk / 2);
+        synth->worker.length = chunk;
+        xTaskNotifyGive(synth->worker.task);
 
-            audio_buffer[i    ] += left;
-            audio_buffer[i + 1] += right;
-        }
+        synth_render_voices(synth, audio_buffer + offset, chunk, 0, 2);
+        xSemaphoreTake(synth->worker.done, portMAX_DELAY);
+
+        dsp_mix_add(audio_buffer + offset, synth->worker.buffer, chunk);
     }
+#else
+    synth_smooth_gain(synth, length / 2);
+    synth_render_voices(synth, audio_buffer, length, 0, 1);
+#endif
 
     // Update voice status
-    for (int j = 0; j < CONFIG_SYNTH_POLYPHONY; j++) {
-        synth_voice_t* voice = &synth->state.voices[j];
-        voice->active = voice->env1->state.status != DSP_ADSR_STOPPED;
+    synth->state.clock += length / 2;
+    int n_active = 0;
+
+    for (int j = 0; j < synth->state.n_active; j++) {
+        synth_voice_t* voice = &synth->state.voices[synth->state.active[j]];
+
+        if (voice->env[0].state.status != DSP_ADSR_STOPPED) {
+            synth->state.active[n_active++] = synth->state.active[j];
+        } else {
+            voice->active     = false;
+            voice->idle_since = synth->state.clock;
+            allocator_voice_stopped(synth->state.allocator, synth->state.active[j]);
+        }
+    }
+
+    synth->state.n_active = n_active;
+}
+
+/**
+ * Skip a block of silence instead of rendering it. Only the sample clock is advanced,
+ * so that the LFOs of idle voices still catch up with the skipped time on their next
+ * note-on.
+ */
+void synth_skip(synth_t* synth, size_t length) {
+    synth->state.clock += length / 2;
+}
+
+#if CONFIG_SYNTH_DUAL_CORE
+/**
+ * Worker task on core 0. Sleeps until `synth_process()` hands over a new chunk, renders
+ * every second active voice into the partial buffer and signals completion.
+ */
+static void IRAM_ATTR synth_worker_task(void* parameters) {
+    synth_t* synth = (synth_t*) parameters;
+
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        dsp_mix_clear(synth->worker.buffer, synth->worker.length);
+
+        synth_render_voices(synth, synth->worker.buffer, synth->worker.length, 1, 2);
+        xSemaphoreGive(synth->worker.done);
     }
 }
+#endif
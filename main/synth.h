@@ -11,10 +11,71 @@
 #pragma once
 
 #include <stdbool.h>                        // bool, true, false
+#include <stdint.h>                         // uint32_t
+#include <string.h>                         // memcpy()
+#include "sdkconfig.h"                      // CONFIG_SYNTH_xyz
+#include "allocator.h"
 #include "dsp/adsr.h"
+#include "dsp/mix.h"
 #include "dsp/oscil.h"
+#include "dsp/sample.h"
 #include "dsp/wavetable.h"
 
+#if CONFIG_SYNTH_DUAL_CORE
+    #include <freertos/FreeRTOS.h>          // Common FreeRTOS (must come first)
+    #include <freertos/task.h>              // TaskHandle_t
+    #include <freertos/semphr.h>            // SemaphoreHandle_t
+#endif
+
+/**
+ * Number of stereo frames rendered at once by the voice kernels. Each voice is
+ * rendered into scratch blocks of this size on the stack, which are then mixed
+ * into the output buffer.
+ */
+#define SYNTH_BLOCK_FRAMES 64
+
+/**
+ * Length of the fade-out in stereo frames, when the polyphony governor sheds a voice.
+ */
+#define SYNTH_FADE_FRAMES (4 * SYNTH_BLOCK_FRAMES)
+
+/**
+ * Number of FM operators (oscillator with envelope generator) per voice and number of
+ * FM algorithms for that many operators, see `synth_set_algorithm()`.
+ */
+#if CONFIG_SYNTH_OPERATORS_6
+    #define SYNTH_N_OPERATORS  (6)
+    #define SYNTH_N_ALGORITHMS (32)
+    #define SYNTH_N_MODULATORS (3)          // Most modulators of one operator in any algorithm
+#elif CONFIG_SYNTH_OPERATORS_4
+    #define SYNTH_N_OPERATORS  (4)
+    #define SYNTH_N_ALGORITHMS (8)
+    #define SYNTH_N_MODULATORS (2)
+#else
+    #define SYNTH_N_OPERATORS  (2)
+    #define SYNTH_N_ALGORITHMS (2)
+    #define SYNTH_N_MODULATORS (1)
+#endif
+
+/**
+ * Highest FM index of a modulator, so that the summed modulators of an operator stay within
+ * the phase range of the float oscillator, see `DSP_OSCIL_FM_INDEX_MAX`. Higher indices are
+ * clamped for all engines alike.
+ */
+#define SYNTH_FM_INDEX_MAX (DSP_OSCIL_FM_INDEX_MAX / SYNTH_N_MODULATORS)
+
+/**
+ * FM algorithm: Routing of the operators of a voice, like the algorithms of the Yamaha DX7.
+ * For each operator it contains the bit mask of the operators modulating it, and for the
+ * output the bit mask of the carriers. Operators are only modulated by operators with a
+ * higher index, so that rendering them from the highest to the lowest index evaluates each
+ * modulator before its carrier. Operator 0 is a carrier in all algorithms.
+ */
+typedef struct {
+    uint8_t modulators[SYNTH_N_OPERATORS];  // Modulation sources of each operator (bit mask)
+    uint8_t carriers;                       // Operators mixed into the output (bit mask)
+} synth_algorithm_t;
+
 /**
  * Internal state of a tone-generating voice.
  */
@@ -24,17 +85,40 @@ typedef struct {
     float velocity;                         // Velocity
     float direction;                        // Panorama change delta
 
-    dsp_oscil_t* osc1;                      // Carrier: Wavetable oscillator
-    dsp_adsr_t*  env1;                      // Carrier: Amplitude envelope generator
+    dsp_oscil_t* osc;                       // Operators: Wavetable oscillators (`SYNTH_N_OPERATORS` in a row)
+    dsp_adsr_t*  env;                       // Operators: Amplitude envelope generators (`SYNTH_N_OPERATORS` in a row)
     dsp_oscil_t* lfo1;                      // LFO hard-wired to panorama
 
-    dsp_oscil_t* osc2;                      // Modulator: Wavetable oscillator
-    dsp_adsr_t*  env2;                      // Modulator: Amplitude envelope generator
+    float fm_index[SYNTH_N_OPERATORS];      // Modulators: FM Index
+    float fm_ratio[SYNTH_N_OPERATORS];      // Modulators: FM Ratio (1.0 for carriers)
+
+    int32_t   fm_index_q12[SYNTH_N_OPERATORS]; // Modulators: FM Index (Q12 for the fixed-point engine)
+    dsp_log_t fm_index_log[SYNTH_N_OPERATORS]; // Modulators: FM Index (attenuation for the log-domain engine)
 
-    float fm_index_2_1;                     // OSC2->OSC1: FM Index
-    float fm_ratio_2_1;                     // OSC2->OSC1: FM Ratio
+    float     pan_left,     pan_right;      // LFO1->Pan: Gains at the end of the last block
+    q15_t     pan_left_q15, pan_right_q15;  // LFO1->Pan: Gains (Q15 for the fixed-point engine)
+    dsp_log_t pan_left_log, pan_right_log;  // LFO1->Pan: Gains (attenuation for the log-domain engine)
+
+    uint32_t idle_since;                    // Sample clock when the voice became inactive
+    uint32_t fade;                          // Remaining frames of the fade-out, when shed by the polyphony governor
 } synth_voice_t;
 
+#if CONFIG_SYNTH_VOICE_POOL
+/**
+ * All voices with their oscillators and envelope generators in one allocation. Each kind of
+ * building block has its own array, in which the operators of a voice follow each other, so
+ * that rendering all operators of consecutive voices walks through contiguous memory. The
+ * pointers in the voices point into these arrays.
+ */
+typedef struct {
+    synth_voice_t voices[CONFIG_SYNTH_POLYPHONY];   // Voices
+
+    dsp_oscil_t   osc[CONFIG_SYNTH_POLYPHONY][SYNTH_N_OPERATORS]; // Operator oscillators
+    dsp_adsr_t    env[CONFIG_SYNTH_POLYPHONY][SYNTH_N_OPERATORS]; // Operator envelope generators
+    dsp_oscil_t   lfo1[CONFIG_SYNTH_POLYPHONY];     // Panorama LFOs
+} synth_voice_pool_t;
+#endif
+
 /**
  * Configuration parameters for the FM synthesis
  */
@@ -42,27 +126,75 @@ typedef struct {
         int    n_ratios;
         float* ratios;
         float  index_min;
-        float  index_max;
+        float  index_max;                   // At most `DSP_OSCIL_LOG_FM_INDEX_MAX` for the log engine
 } synth_fm_params;
 
 /**
- * A very simple, polyphonic wavetable synthesizer. Nothing to write home about. :-)
+ * Sound parameters of the synthesizer.
  */
 typedef struct {
-    volatile struct {
-        float volume;                       // Overall volume
+    float volume;                           // Overall volume
+
+    dsp_adsr_values_t env1;                 // Carriers: Amplitude envelope generator parameters
+    dsp_adsr_values_t env2;                 // Modulators: Amplitude envelope generator parameters
+    synth_fm_params   fm;                   // Frequency modulation parameters
+    int               algorithm;            // FM algorithm (index into `synth_algorithms`)
+} synth_params_t;
+
+/**
+ * Number of stereo frames after which a volume change has taken effect by about two thirds
+ * (time constant of the one-pole smoothing of the master gain).
+ */
+#define SYNTH_GAIN_SMOOTHING_FRAMES (512)
 
-        dsp_adsr_values_t env1;             // Carrier: Amplitude envelope generator parameters
-        dsp_adsr_values_t env2;             // Modulator: Amplitude envelope generator parameters
-        synth_fm_params   fm;               // Frequency modulation parameters
-    } params;
+/**
+ * A very simple, polyphonic wavetable synthesizer. Nothing to write home about. :-)
+ *
+ * The parameters are double-buffered: The setter functions only write the pending
+ * parameters, which `synth_process()` copies into its snapshot once at the beginning
+ * of each call. The voice kernels only read the snapshot, so that the parameters stay
+ * constant for the whole block and can be kept in registers.
+ */
+typedef struct {
+    volatile synth_params_t params;         // Pending parameters, written by the setters
+    volatile bool           params_changed; // Pending parameters differ from the snapshot
 
     struct {
         int   polyphony;                    // Number of voices
         float gain_staging;                 // Gain factor to avoid clipping
 
+        synth_params_t params;              // Snapshot of the parameters for the current block
+        const synth_algorithm_t* algorithm; // FM algorithm of the snapshot
+        float          carrier_gain;        // Gain of each carrier, so that all carriers add up to 1.0
+        int32_t        carrier_gain_q12;    // Gain of each carrier (Q12 for the fixed-point engine)
+        dsp_log_t      carrier_gain_log;    // Gain of each carrier (attenuation for the log-domain engine)
+        float          gain_start;          // Master gain (volume and gain staging) at the start of the current block
+        float          gain_end;            // Master gain at the end of the current block (smoothed)
+
         synth_voice_t* voices;              // Voices that actually create sound
+#if CONFIG_SYNTH_VOICE_POOL
+        synth_voice_pool_t* pool;           // Memory of the voices
+#endif
+        allocator_t*   allocator;           // Voice allocation and stealing
+
+        dsp_oscil_pitch_t* pitch1;          // Carriers: Pitch of each note
+        dsp_oscil_pitch_t* pitch2;          // Modulators: Pitch of each note and FM ratio
+        uint32_t           random;          // Random generator state for the FM parameters
+
+        int      n_active;                  // Number of active voices
+        int      max_voices;                // Voice limit of the polyphony governor
+        int      active[CONFIG_SYNTH_POLYPHONY]; // Indices of the active voices (only these are rendered)
+        uint32_t clock;                     // Number of stereo frames rendered so far
     } state;
+
+#if CONFIG_SYNTH_DUAL_CORE
+    struct {
+        TaskHandle_t      task;             // Worker task rendering the second half of the voices
+        SemaphoreHandle_t done;             // Given by the worker when its partial buffer is ready
+        dsp_sample_t*     buffer;           // Partial buffer of the worker task
+        size_t            length;           // Number of samples requested from the worker
+    } worker;
+#endif
 } synth_t;
 
 /**
@@ -72,9 +204,11 @@ typedef struct {
     float volume;                           // Overall volume
 
     dsp_wavetable_t*  wavetable;            // Oscillator wavetable
-    dsp_adsr_values_t env1;                 // Carrier: Amplitude envelope generator parameters
-    dsp_adsr_values_t env2;                 // Modulator: Amplitude envelope generator parameters
+    dsp_adsr_values_t env1;                 // Carriers: Amplitude envelope generator parameters
+    dsp_adsr_values_t env2;                 // Modulators: Amplitude envelope generator parameters
     synth_fm_params   fm;                   // Frequency modulation parameters
+    int               algorithm;            // FM algorithm, see `synth_set_algorithm()`
+    uint32_t          seed;                 // Seed of the random voice parameters (0 for a seed from `rand()`)
 } synth_config_t;
 
 /**
@@ -102,7 +236,7 @@ void synth_free(synth_t* synth);
 void synth_set_volume(synth_t* synth, float volume);
 
 /**
- * Set parameters of the carrier amplitude envelope generator.
+ * Set parameters of the amplitude envelope generators of the carriers.
  *
  * @param synth Synthesizer instance
  * @param env1 Attack, decay, sustain, release
@@ -110,15 +244,30 @@ void synth_set_volume(synth_t* synth, float volume);
 void synth_set_env1_values(synth_t* synth, dsp_adsr_values_t env1);
 
 /**
- * Set parameters of the modulator amplitude envelope generator.
+ * Set parameters of the amplitude envelope generators of the modulators.
  *
  * @param synth Synthesizer instance
  * @param env1 Attack, decay, sustain, release
  */
 void synth_set_env2_values(synth_t* synth, dsp_adsr_values_t env2);
 
+/**
+ * Select the FM algorithm, i.e. which operators modulate which and which are heard.
+ * The algorithms are numbered like those of the Yamaha synthesizer with the same
+ * number of operators, counting from zero: With six operators the 32 algorithms of
+ * the DX7, with four operators the eight algorithms of the DX21/TX81Z, with two
+ * operators 0 for FM and 1 for two carriers. The operator index is the DX7 operator
+ * number minus one. Operator feedback is not implemented. The algorithm also applies
+ * to sounding notes, but the FM ratios and indices are only drawn at note-on.
+ *
+ * @param synth Synthesizer instance
+ * @param algorithm Algorithm number [0 … SYNTH_N_ALGORITHMS - 1]
+ */
+void synth_set_algorithm(synth_t* synth, int algorithm);
+
 /**
  * Play a new note or re-trigger an already playing note of the same number.
+ * This takes constant time regardless of the polyphony, see `allocator_note_on()`.
  *
  * @param synth Synthesizer instance
  * @param note MIDI note number
@@ -134,12 +283,119 @@ void synth_note_on(synth_t* synth, int note, float velocity);
  */
 void synth_note_off(synth_t* synth, int note);
 
+#if CONFIG_SYNTH_GOVERNOR
+/**
+ * Polyphony governor: Adapt the number of sounding voices to the DSP load measured
+ * for the last block. Must be called by the DSP task once per block. Above
+ * `CONFIG_SYNTH_GOVERNOR_MAX_LOAD` the voice limit is lowered in proportion to the
+ * load and the quietest voices are faded out. Once the load of one more voice fits
+ * again, the limit is raised by one voice per block up to `CONFIG_SYNTH_POLYPHONY`.
+ * New notes are never rejected. Instead the quietest other voice is faded out.
+ *
+ * @param synth Synthesizer instance
+ * @param load DSP load of the last block in percent
+ */
+void synth_govern(synth_t* synth, float load);
+#endif
+
+/**
+ * Advance the fade-out of a voice shed by the polyphony governor. Used by the voice
+ * kernels after they rendered a block of `n` frames. When the fade-out is complete,
+ * the envelope generators are stopped, so that `synth_process()` frees the voice.
+ *
+ * @param voice Voice
+ * @param n Number of rendered frames
+ */
+static inline void synth_voice_fade_step(synth_voice_t* voice, uint32_t n) {
+    voice->fade = n < voice->fade ? voice->fade - n : 0;
+
+    if (!voice->fade) {
+        for (int op = 0; op < SYNTH_N_OPERATORS; op++) dsp_adsr_stop(&voice->env[op]);
+    }
+}
+
+/**
+ * Modulator input of an operator for the integer voice kernels: `NULL` without modulators,
+ * the output block of the only modulator, or the sum of all modulators in `sum`. Modulators
+ * are given by the bit mask of the algorithm. The outputs are summed in 32 bits, so that
+ * several full-scale modulators don't overflow.
+ *
+ * @param out Output blocks of all operators
+ * @param modulators Bit mask of the modulating operators
+ * @param sum [out] Scratch block for the sum of several modulators
+ * @param n Number of frames
+ * @returns Modulator input or `NULL`
+ */
+static inline const int32_t* synth_voice_modulator_i32(int32_t out[][SYNTH_BLOCK_FRAMES], uint32_t modulators, int32_t* sum, size_t n) {
+    if (!modulators) return NULL;
+
+    int op = __builtin_ctz(modulators);
+    modulators &= modulators - 1;
+    if (!modulators) return out[op];
+
+    memcpy(sum, out[op], n * sizeof(int32_t));
+
+    while (modulators) {
+        const int32_t* input = out[__builtin_ctz(modulators)];
+        for (size_t i = 0; i < n; i++) sum[i] += input[i];
+        modulators &= modulators - 1;
+    }
+
+    return sum;
+}
+
+/**
+ * Output stage of the voice kernels: Add the mix of all voices of one block, starting
+ * at `offset` within a buffer of `length` samples, to the audio buffer with the master
+ * gain. The gain ramps from `gain_start` to `gain_end` over the whole buffer, so that
+ * consecutive blocks and both CPU cores in dual-core mode ramp seamlessly.
+ *
+ * @param synth Synthesizer instance
+ * @param output Audio buffer at `offset`
+ * @param mix Mix of all voices of the block
+ * @param offset Offset of the block within the buffer in samples
+ * @param length Length of the whole buffer in samples
+ * @param n Number of samples in the block
+ */
+static inline void synth_mix_output(synth_t* synth, dsp_sample_t* output, const dsp_sample_t* mix, size_t offset, size_t length, size_t n) {
+    float gain_step = (synth->state.gain_end - synth->state.gain_start) / length;
+    float gain0     = synth->state.gain_start + gain_step * offset;
+    float gain1     = synth->state.gain_start + gain_step * (offset + n);
+
+    dsp_mix_add_ramp(output, mix, gain0, gain1, n);
+}
+
 /**
  * Render a new block of audio with the currently set parameters and notes.
- * The buffer is expected to be two-channel left/right interleaved.
+ * The buffer is expected to be two-channel left/right interleaved. Its sample type
+ * depends on the configured DSP engine (float or Q15 in 32-bit integers).
+ *
+ * Only the active voices are rendered, so that the processing time depends on the
+ * number of sounding notes rather than the configured polyphony.
+ *
+ * The length can be any even number of samples, so that a processing cycle can be
+ * split at the sample where the next note event is due. Splitting costs nothing but
+ * the function call and, in dual-core mode, one more synchronization of both tasks.
+ *
+ * With `CONFIG_SYNTH_DUAL_CORE` half of the voices are rendered by a worker task on
+ * the other CPU core, while the calling task renders the other half. The function
+ * returns once both halves have been mixed into the buffer.
+ *
+ * Parameter changes take effect at the beginning of the call. The master gain (volume
+ * and gain staging) is applied once to the mix of all voices, with volume changes
+ * smoothed over `SYNTH_GAIN_SMOOTHING_FRAMES` to avoid zipper noise.
  *
  * @param synth Synthesizer instance
  * @param audio_buffer Audio buffer to render into
  * @param length Length of the audio buffer
  */
-void synth_process(synth_t* synth, float* audio_buffer, size_t length);
+void synth_process(synth_t* synth, dsp_sample_t* audio_buffer, size_t length);
+
+/**
+ * Advance the synthesizer by a block that is not rendered, because the DSP task skips
+ * a processing cycle of silence. Must only be called while no voice is active.
+ *
+ * @param synth Synthesizer instance
+ * @param length Length of the skipped block, counted like for `synth_process()`
+ */
+void synth_skip(synth_t* synth, size_t length);
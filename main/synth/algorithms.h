@@ -0,0 +1,81 @@
+/*
+ * Klimper: ESP32 I²S Synthesizer Test
+ * © 2024 Dennis Schulmeister-Zimolong <dennis@wpvs.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ */
+
+//////////////////////////////////////////////////////
+// FM algorithms for the configured operator count  //
+//////////////////////////////////////////////////////
+
+#pragma once
+
+#include "../synth.h"
+
+/**
+ * Bit of an operator given by its number on the Yamaha synthesizers (counting from one).
+ */
+#define OP(n) (1u << ((n) - 1))
+
+/**
+ * Algorithm table, only included by `synth.c`. Each entry lists the modulators of the
+ * operators, e.g. `[0] = OP(2)` for "operator 2 modulates operator 1", and the carriers.
+ * Operator feedback of the originals is left out.
+ */
+static const synth_algorithm_t synth_algorithms[SYNTH_N_ALGORITHMS] = {
+#if SYNTH_N_OPERATORS == 6
+    // Yamaha DX7
+    /*  1 */ { .modulators = { [0] = OP(2), [2] = OP(4), [3] = OP(5), [4] = OP(6) },        .carriers = OP(1) | OP(3) },
+    /*  2 */ { .modulators = { [0] = OP(2), [2] = OP(4), [3] = OP(5), [4] = OP(6) },        .carriers = OP(1) | OP(3) },
+    /*  3 */ { .modulators = { [0] = OP(2), [1] = OP(3), [3] = OP(5), [4] = OP(6) },        .carriers = OP(1) | OP(4) },
+    /*  4 */ { .modulators = { [0] = OP(2), [1] = OP(3), [3] = OP(5), [4] = OP(6) },        .carriers = OP(1) | OP(4) },
+    /*  5 */ { .modulators = { [0] = OP(2), [2] = OP(4), [4] = OP(6) },                     .carriers = OP(1) | OP(3) | OP(5) },
+    /*  6 */ { .modulators = { [0] = OP(2), [2] = OP(4), [4] = OP(6) },                     .carriers = OP(1) | OP(3) | OP(5) },
+    /*  7 */ { .modulators = { [0] = OP(2), [2] = OP(4) | OP(5), [4] = OP(6) },             .carriers = OP(1) | OP(3) },
+    /*  8 */ { .modulators = { [0] = OP(2), [2] = OP(4) | OP(5), [4] = OP(6) },             .carriers = OP(1) | OP(3) },
+    /*  9 */ { .modulators = { [0] = OP(2), [2] = OP(4) | OP(5), [4] = OP(6) },             .carriers = OP(1) | OP(3) },
+    /* 10 */ { .modulators = { [0] = OP(2), [1] = OP(3), [3] = OP(5) | OP(6) },             .carriers = OP(1) | OP(4) },
+    /* 11 */ { .modulators = { [0] = OP(2), [1] = OP(3), [3] = OP(5) | OP(6) },             .carriers = OP(1) | OP(4) },
+    /* 12 */ { .modulators = { [0] = OP(2), [2] = OP(4) | OP(5) | OP(6) },                  .carriers = OP(1) | OP(3) },
+    /* 13 */ { .modulators = { [0] = OP(2), [2] = OP(4) | OP(5) | OP(6) },                  .carriers = OP(1) | OP(3) },
+    /* 14 */ { .modulators = { [0] = OP(2), [2] = OP(4), [3] = OP(5) | OP(6) },             .carriers = OP(1) | OP(3) },
+    /* 15 */ { .modulators = { [0] = OP(2), [2] = OP(4), [3] = OP(5) | OP(6) },             .carriers = OP(1) | OP(3) },
+    /* 16 */ { .modulators = { [0] = OP(2) | OP(3) | OP(5), [2] = OP(4), [4] = OP(6) },     .carriers = OP(1) },
+    /* 17 */ { .modulators = { [0] = OP(2) | OP(3) | OP(5), [2] = OP(4), [4] = OP(6) },     .carriers = OP(1) },
+    /* 18 */ { .modulators = { [0] = OP(2) | OP(3) | OP(4), [3] = OP(5), [4] = OP(6) },     .carriers = OP(1) },
+    /* 19 */ { .modulators = { [0] = OP(2), [1] = OP(3), [3] = OP(6), [4] = OP(6) },        .carriers = OP(1) | OP(4) | OP(5) },
+    /* 20 */ { .modulators = { [0] = OP(3), [1] = OP(3), [3] = OP(5) | OP(6) },             .carriers = OP(1) | OP(2) | OP(4) },
+    /* 21 */ { .modulators = { [0] = OP(3), [1] = OP(3), [3] = OP(6), [4] = OP(6) },        .carriers = OP(1) | OP(2) | OP(4) | OP(5) },
+    /* 22 */ { .modulators = { [0] = OP(2), [2] = OP(6), [3] = OP(6), [4] = OP(6) },        .carriers = OP(1) | OP(3) | OP(4) | OP(5) },
+    /* 23 */ { .modulators = { [1] = OP(3), [3] = OP(6), [4] = OP(6) },                     .carriers = OP(1) | OP(2) | OP(4) | OP(5) },
+    /* 24 */ { .modulators = { [2] = OP(6), [3] = OP(6), [4] = OP(6) },                     .carriers = OP(1) | OP(2) | OP(3) | OP(4) | OP(5) },
+    /* 25 */ { .modulators = { [3] = OP(6), [4] = OP(6) },                                  .carriers = OP(1) | OP(2) | OP(3) | OP(4) | OP(5) },
+    /* 26 */ { .modulators = { [1] = OP(3), [3] = OP(5) | OP(6) },                          .carriers = OP(1) | OP(2) | OP(4) },
+    /* 27 */ { .modulators = { [1] = OP(3), [3] = OP(5) | OP(6) },                          .carriers = OP(1) | OP(2) | OP(4) },
+    /* 28 */ { .modulators = { [0] = OP(2), [2] = OP(4), [3] = OP(5) },                     .carriers = OP(1) | OP(3) | OP(6) },
+    /* 29 */ { .modulators = { [2] = OP(4), [4] = OP(6) },                                  .carriers = OP(1) | OP(2) | OP(3) | OP(5) },
+    /* 30 */ { .modulators = { [2] = OP(4), [3] = OP(5) },                                  .carriers = OP(1) | OP(2) | OP(3) | OP(6) },
+    /* 31 */ { .modulators = { [4] = OP(6) },                                               .carriers = OP(1) | OP(2) | OP(3) | OP(4) | OP(5) },
+    /* 32 */ { .modulators = { 0 },                                                         .carriers = OP(1) | OP(2) | OP(3) | OP(4) | OP(5) | OP(6) },
+#elif SYNTH_N_OPERATORS == 4
+    // Yamaha DX21/TX81Z
+    /*  1 */ { .modulators = { [0] = OP(2), [1] = OP(3), [2] = OP(4) },                     .carriers = OP(1) },
+    /*  2 */ { .modulators = { [0] = OP(2), [1] = OP(3) | OP(4) },                          .carriers = OP(1) },
+    /*  3 */ { .modulators = { [0] = OP(2) | OP(4), [1] = OP(3) },                          .carriers = OP(1) },
+    /*  4 */ { .modulators = { [0] = OP(2) | OP(3), [2] = OP(4) },                          .carriers = OP(1) },
+    /*  5 */ { .modulators = { [0] = OP(2), [2] = OP(4) },                                  .carriers = OP(1) | OP(3) },
+    /*  6 */ { .modulators = { [0] = OP(4), [1] = OP(4), [2] = OP(4) },                     .carriers = OP(1) | OP(2) | OP(3) },
+    /*  7 */ { .modulators = { [2] = OP(4) },                                               .carriers = OP(1) | OP(2) | OP(3) },
+    /*  8 */ { .modulators = { 0 },                                                         .carriers = OP(1) | OP(2) | OP(3) | OP(4) },
+#else
+    // Classic two-operator FM and two carriers
+    /*  1 */ { .modulators = { [0] = OP(2) },                                               .carriers = OP(1) },
+    /*  2 */ { .modulators = { 0 },                                                         .carriers = OP(1) | OP(2) },
+#endif
+};
+
+#undef OP
@@ -0,0 +1,124 @@
+/*
+ * Klimper: ESP32 I²S Synthesizer Test
+ * © 2024 Dennis Schulmeister-Zimolong <dennis@wpvs.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ */
+
+/////////////////////////////////////////////////////
+// Voice kernel with fixed-point numbers (Q15/Q31) //
+/////////////////////////////////////////////////////
+
+#include "../synth.h"
+
+#include <esp_attr.h>                       // IRAM_ATTR
+#include "../dsp/adsr.h"                    // dsp_adsr_process_q15()
+#include "../dsp/oscil.h"                   // dsp_oscil_process_q15()
+#include "../dsp/pan.h"                     // dsp_pan_gains_q15(), dsp_pan_mix_ramp_q15()
+#include "../dsp/sample.h"                  // q15_t, dsp_q15_xyz()
+
+/**
+ * Wavetable for the voice oscillators.
+ */
+static inline dsp_wavetable_t* synth_voice_wavetable(synth_config_t* config) {
+    return config->wavetable;
+}
+
+/**
+ * Current amplitude of a voice for the polyphony governor.
+ */
+static inline float synth_voice_level(synth_voice_t* voice) {
+    return voice->velocity * voice->env[0].state.value_q31 * (1.0f / 2147483648.0f);
+}
+
+/**
+ * Advance the panorama LFO of a voice by `n` frames and evaluate the pan law for the
+ * last of them. See the floating-point kernel.
+ */
+static inline void synth_voice_pan(synth_voice_t* voice, uint32_t n, q15_t* left, q15_t* right) {
+    if (n > 1) dsp_oscil_skip(voice->lfo1, n - 1);
+    dsp_pan_gains_q15((dsp_oscil_tick_q15(voice->lfo1, 0) * 3) >> 2, left, right);
+}
+
+/**
+ * Start the gain ramps of a newly activated voice at its current LFO position.
+ */
+static inline void synth_voice_init_pan(synth_voice_t* voice) {
+    synth_voice_pan(voice, 1, &voice->pan_left_q15, &voice->pan_right_q15);
+}
+
+/**
+ * Fade-out gains of a voice shed by the polyphony governor. See the floating-point kernel.
+ */
+static inline void synth_voice_fade(synth_voice_t* voice, uint32_t n, q15_t* left, q15_t* right) {
+    int32_t remaining = n < voice->fade ? voice->fade - n : 0;
+
+    *left  = (q15_t) (voice->pan_left_q15  * remaining / (int32_t) voice->fade);
+    *right = (q15_t) (voice->pan_right_q15 * remaining / (int32_t) voice->fade);
+}
+
+/**
+ * Mix the given subset of voices into the output buffer. Same voice architecture
+ * as the floating-point kernel, but completely in Q15. The output buffer contains
+ * Q15 samples in 32-bit integers, which are saturated when converted for the DAC.
+ * The voices are mixed at full scale, so that the master gain needs only one
+ * multiplication per output sample. The modulator outputs are kept in 32 bits,
+ * since the FM index may scale them beyond Q15.
+ */
+static void IRAM_ATTR synth_render_voices(synth_t* synth, dsp_sample_t* audio_buffer, size_t length, int first, int stride) {
+    if (first >= synth->state.n_active) return;
+
+    const synth_algorithm_t* algorithm = synth->state.algorithm;
+    int32_t carrier_gain = synth->state.carrier_gain_q12;
+
+    int32_t out[SYNTH_N_OPERATORS][SYNTH_BLOCK_FRAMES];
+    int32_t mod[SYNTH_BLOCK_FRAMES];
+    q15_t   osc[SYNTH_BLOCK_FRAMES];
+    q15_t   env[SYNTH_BLOCK_FRAMES];
+    int32_t mix[2 * SYNTH_BLOCK_FRAMES];
+
+    for (size_t offset = 0; offset < length; offset += 2 * SYNTH_BLOCK_FRAMES) {
+        size_t n = (length - offset) / 2;
+        if (n > SYNTH_BLOCK_FRAMES) n = SYNTH_BLOCK_FRAMES;
+
+        dsp_mix_clear(mix, 2 * n);
+
+        for (int j = first; j < synth->state.n_active; j += stride) {
+            synth_voice_t* voice = &synth->state.voices[synth->state.active[j]];
+
+            q15_t left, right;
+            synth_voice_pan(voice, n, &left, &right);
+            if (voice->fade) synth_voice_fade(voice, n, &left, &right);
+
+            for (int op = SYNTH_N_OPERATORS - 1; op >= 0; op--) {
+                const int32_t* modulator = synth_voice_modulator_i32(out, algorithm->modulators[op], mod, n);
+
+                dsp_oscil_process_q15(&voice->osc[op], modulator, osc, n);
+                dsp_adsr_process_q15(&voice->env[op], env, n);
+
+                if (algorithm->carriers & (1 << op)) {
+                    for (size_t i = 0; i < n; i++) osc[i] = dsp_q15_mul(osc[i], env[i]);
+
+                    dsp_pan_mix_ramp_q15(
+                        osc,
+                        (q15_t) ((voice->pan_left_q15 * carrier_gain) >> 12), (q15_t) ((voice->pan_right_q15 * carrier_gain) >> 12),
+                        (q15_t) ((left * carrier_gain) >> 12), (q15_t) ((right * carrier_gain) >> 12),
+                        mix, n
+                    );
+                } else {
+                    int32_t fm_index = voice->fm_index_q12[op];
+                    for (size_t i = 0; i < n; i++) out[op][i] = (dsp_q15_mul(osc[i], env[i]) * fm_index) >> 12;
+                }
+            }
+
+            voice->pan_left_q15  = left;
+            voice->pan_right_q15 = right;
+            if (voice->fade) synth_voice_fade_step(voice, n);
+        }
+
+        synth_mix_output(synth, audio_buffer + offset, mix, offset, length, 2 * n);
+    }
+}
@@ -0,0 +1,147 @@
+/*
+ * Klimper: ESP32 I²S Synthesizer Test
+ * © 2024 Dennis Schulmeister-Zimolong <dennis@wpvs.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ */
+
+//////////////////////////////////////////////
+// Voice kernel with floating-point numbers //
+//////////////////////////////////////////////
+
+#include "../synth.h"
+
+#include <esp_attr.h>                       // IRAM_ATTR
+#include <string.h>                         // memcpy()
+#include "../dsp/adsr.h"                    // dsp_adsr_process()
+#include "../dsp/mix.h"                     // dsp_mix_mul_f32(), dsp_mix_mulc_f32()
+#include "../dsp/oscil.h"                   // dsp_oscil_process(), dsp_oscil_skip()
+#include "../dsp/pan.h"                     // dsp_pan_gains(), dsp_pan_mix_ramp()
+
+/**
+ * Wavetable for the voice oscillators.
+ */
+static inline dsp_wavetable_t* synth_voice_wavetable(synth_config_t* config) {
+    return config->wavetable;
+}
+
+/**
+ * Current amplitude of a voice for the polyphony governor.
+ */
+static inline float synth_voice_level(synth_voice_t* voice) {
+    return voice->velocity * voice->env[0].state.value;
+}
+
+/**
+ * Advance the panorama LFO of a voice by `n` frames and evaluate the pan law for the
+ * last of them. The LFO runs at control rate, since its value is only needed once
+ * per block to calculate the target of the gain ramps.
+ */
+static inline void synth_voice_pan(synth_voice_t* voice, uint32_t n, float* left, float* right) {
+    if (n > 1) dsp_oscil_skip(voice->lfo1, n - 1);
+    dsp_pan_gains(dsp_oscil_tick(voice->lfo1, 0.0f) * 0.75f, left, right);
+}
+
+/**
+ * Start the gain ramps of a newly activated voice at its current LFO position.
+ */
+static inline void synth_voice_init_pan(synth_voice_t* voice) {
+    synth_voice_pan(voice, 1, &voice->pan_left, &voice->pan_right);
+}
+
+/**
+ * Fade-out gains of a voice shed by the polyphony governor. Instead of following the LFO
+ * the gains ramp linearly to zero within `SYNTH_FADE_FRAMES`.
+ */
+static inline void synth_voice_fade(synth_voice_t* voice, uint32_t n, float* left, float* right) {
+    float ratio = n < voice->fade ? (float) (voice->fade - n) / voice->fade : 0.0f;
+
+    *left  = voice->pan_left  * ratio;
+    *right = voice->pan_right * ratio;
+}
+
+/**
+ * Modulator input of an operator: `NULL` without modulators, the output block of the
+ * only modulator, or the sum of all modulators in `sum`. Modulators are given by the
+ * bit mask of the algorithm.
+ */
+static inline const float* synth_voice_modulator(float out[][SYNTH_BLOCK_FRAMES], uint32_t modulators, float* sum, size_t n) {
+    if (!modulators) return NULL;
+
+    int op = __builtin_ctz(modulators);
+    modulators &= modulators - 1;
+    if (!modulators) return out[op];
+
+    memcpy(sum, out[op], n * sizeof(float));
+
+    while (modulators) {
+        dsp_mix_add_f32(sum, 1, out[__builtin_ctz(modulators)], n);
+        modulators &= modulators - 1;
+    }
+
+    return sum;
+}
+
+/**
+ * Mix the given subset of active voices into the output buffer. Starting with the
+ * `first` entry of the active voice list every `stride`-th voice is rendered, so that
+ * the voices can be shared between the two CPU cores. Rendering is voice-major: Each
+ * voice is rendered block-wise into scratch buffers, before the block is mixed into a
+ * stereo block buffer. The master gain is applied only once to that mix, when it is
+ * added to the output buffer.
+ *
+ * The operators are rendered from the highest to the lowest index, so that the output
+ * blocks of all modulators of an operator are ready when it is rendered. Every operator
+ * runs the same steps, only the algorithm table decides where its input comes from and
+ * whether its output goes to the next operators (scaled to phase units with the FM index)
+ * or to the mix (panned with the carrier gain).
+ */
+static void IRAM_ATTR synth_render_voices(synth_t* synth, dsp_sample_t* audio_buffer, size_t length, int first, int stride) {
+    if (first >= synth->state.n_active) return;
+
+    const synth_algorithm_t* algorithm = synth->state.algorithm;
+    float carrier_gain = synth->state.carrier_gain;
+
+    float out[SYNTH_N_OPERATORS][SYNTH_BLOCK_FRAMES];
+    float mod[SYNTH_BLOCK_FRAMES];
+    float env[SYNTH_BLOCK_FRAMES];
+    float mix[2 * SYNTH_BLOCK_FRAMES];
+
+    for (size_t offset = 0; offset < length; offset += 2 * SYNTH_BLOCK_FRAMES) {
+        size_t n = (length - offset) / 2;
+        if (n > SYNTH_BLOCK_FRAMES) n = SYNTH_BLOCK_FRAMES;
+
+        dsp_mix_clear(mix, 2 * n);
+
+        for (int j = first; j < synth->state.n_active; j += stride) {
+            synth_voice_t* voice = &synth->state.voices[synth->state.active[j]];
+
+            float left, right;
+            synth_voice_pan(voice, n, &left, &right);
+            if (voice->fade) synth_voice_fade(voice, n, &left, &right);
+
+            for (int op = SYNTH_N_OPERATORS - 1; op >= 0; op--) {
+                const float* modulator = synth_voice_modulator(out, algorithm->modulators[op], mod, n);
+
+                dsp_oscil_process(&voice->osc[op], modulator, out[op], n);
+                dsp_adsr_process(&voice->env[op], env, n);
+                dsp_mix_mul_f32(out[op], env, n);
+
+                if (algorithm->carriers & (1 << op)) {
+                    dsp_pan_mix_ramp(out[op], voice->pan_left * carrier_gain, voice->pan_right * carrier_gain, left * carrier_gain, right * carrier_gain, mix, n);
+                } else {
+                    dsp_mix_mulc_f32(out[op], voice->fm_index[op] * DSP_OSCIL_FM_SCALE, n);
+                }
+            }
+
+            voice->pan_left  = left;
+            voice->pan_right = right;
+            if (voice->fade) synth_voice_fade_step(voice, n);
+        }
+
+        synth_mix_output(synth, audio_buffer + offset, mix, offset, length, 2 * n);
+    }
+}
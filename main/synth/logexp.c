@@ -0,0 +1,133 @@
+/*
+ * Klimper: ESP32 I²S Synthesizer Test
+ * © 2024 Dennis Schulmeister-Zimolong <dennis@wpvs.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ */
+
+///////////////////////////////////////////////////////////
+// Voice kernel with DX7-style log-sine and exp tables   //
+///////////////////////////////////////////////////////////
+
+#include "../synth.h"
+
+#include <esp_attr.h>                       // IRAM_ATTR
+#include <math.h>                           // exp2f()
+#include "../dsp/adsr.h"                    // dsp_adsr_process_log()
+#include "../dsp/oscil.h"                   // dsp_oscil_process_log()
+#include "../dsp/pan.h"                     // dsp_pan_gains_log(), dsp_pan_mix_ramp_log()
+#include "../dsp/sample.h"                  // dsp_log_t, dsp_log_xyz()
+#include "../dsp/wavetable.h"               // dsp_wavetable_read_exp2()
+
+/**
+ * Wavetable for the voice oscillators. The log-domain oscillators only work with
+ * the log-sine table, so the configured wavetable cannot be used here.
+ */
+static inline dsp_wavetable_t* synth_voice_wavetable(synth_config_t* config) {
+    return dsp_wavetable_get(DSP_WAVETABLE_LOGSIN);
+}
+
+/**
+ * Current amplitude of a voice for the polyphony governor.
+ */
+static inline float synth_voice_level(synth_voice_t* voice) {
+    return voice->velocity * exp2f((voice->env[0].state.value_log >> 16) * (-1.0f / DSP_LOG_OCTAVE));
+}
+
+/**
+ * Advance the panorama LFO of a voice by `n` frames and evaluate the pan law for the
+ * last of them. See the floating-point kernel.
+ */
+static inline void synth_voice_pan(synth_voice_t* voice, uint32_t n, dsp_log_t* left, dsp_log_t* right) {
+    if (n > 1) dsp_oscil_skip(voice->lfo1, n - 1);
+
+    int32_t lfo = dsp_wavetable_read_exp2(dsp_pan_wt_exp2, dsp_oscil_tick_log(voice->lfo1, 0));
+    dsp_pan_gains_log((q15_t) ((lfo + lfo + lfo) >> 2), left, right);
+}
+
+/**
+ * Start the gain ramps of a newly activated voice at its current LFO position.
+ */
+static inline void synth_voice_init_pan(synth_voice_t* voice) {
+    synth_voice_pan(voice, 1, &voice->pan_left_log, &voice->pan_right_log);
+}
+
+/**
+ * Fade-out gains of a voice shed by the polyphony governor. See the floating-point kernel.
+ * The attenuations ramp linearly to silence, which gives an exponential fade.
+ */
+static inline void synth_voice_fade(synth_voice_t* voice, uint32_t n, dsp_log_t* left, dsp_log_t* right) {
+    int32_t step = n < voice->fade ? n : voice->fade;
+
+    *left  = voice->pan_left_log  + (DSP_LOG_SILENCE - (int32_t) voice->pan_left_log)  * step / (int32_t) voice->fade;
+    *right = voice->pan_right_log + (DSP_LOG_SILENCE - (int32_t) voice->pan_right_log) * step / (int32_t) voice->fade;
+}
+
+/**
+ * Mix the given subset of voices into the output buffer. Same voice architecture as
+ * the other kernels, but all voice gains (envelopes, FM index, carrier gain and pan law)
+ * are added as attenuations in the log domain. Only the exponential table lookups
+ * convert back to linear values, where a modulator is fed into the next operators and
+ * where the carriers are mixed. So there is not a single multiplication per voice and
+ * sample. Only the master gain is multiplied once per output sample, when the mix of
+ * all voices is added to the output buffer.
+ */
+static void IRAM_ATTR synth_render_voices(synth_t* synth, dsp_sample_t* audio_buffer, size_t length, int first, int stride) {
+    if (first >= synth->state.n_active) return;
+
+    dsp_wavetable_t* exp2 = dsp_wavetable_get(DSP_WAVETABLE_EXP2);
+
+    const synth_algorithm_t* algorithm = synth->state.algorithm;
+    dsp_log_t carrier_gain = synth->state.carrier_gain_log;
+
+    int32_t   out[SYNTH_N_OPERATORS][SYNTH_BLOCK_FRAMES];
+    int32_t   mod[SYNTH_BLOCK_FRAMES];
+    dsp_log_t osc[SYNTH_BLOCK_FRAMES];
+    dsp_log_t env[SYNTH_BLOCK_FRAMES];
+    int32_t   mix[2 * SYNTH_BLOCK_FRAMES];
+
+    for (size_t offset = 0; offset < length; offset += 2 * SYNTH_BLOCK_FRAMES) {
+        size_t n = (length - offset) / 2;
+        if (n > SYNTH_BLOCK_FRAMES) n = SYNTH_BLOCK_FRAMES;
+
+        dsp_mix_clear(mix, 2 * n);
+
+        for (int j = first; j < synth->state.n_active; j += stride) {
+            synth_voice_t* voice = &synth->state.voices[synth->state.active[j]];
+
+            dsp_log_t left, right;
+            synth_voice_pan(voice, n, &left, &right);
+            if (voice->fade) synth_voice_fade(voice, n, &left, &right);
+
+            for (int op = SYNTH_N_OPERATORS - 1; op >= 0; op--) {
+                const int32_t* modulator = synth_voice_modulator_i32(out, algorithm->modulators[op], mod, n);
+
+                dsp_oscil_process_log(&voice->osc[op], modulator, osc, n);
+                dsp_adsr_process_log(&voice->env[op], env, n);
+
+                if (algorithm->carriers & (1 << op)) {
+                    for (size_t i = 0; i < n; i++) osc[i] += env[i];
+
+                    dsp_pan_mix_ramp_log(
+                        osc,
+                        voice->pan_left_log + carrier_gain, voice->pan_right_log + carrier_gain,
+                        left + carrier_gain, right + carrier_gain,
+                        mix, n
+                    );
+                } else {
+                    dsp_log_t fm_index = voice->fm_index_log[op];
+                    for (size_t i = 0; i < n; i++) out[op][i] = dsp_wavetable_read_exp2(exp2, osc[i] + env[i] + fm_index);
+                }
+            }
+
+            voice->pan_left_log  = left;
+            voice->pan_right_log = right;
+            if (voice->fade) synth_voice_fade_step(voice, n);
+        }
+
+        synth_mix_output(synth, audio_buffer + offset, mix, offset, length, 2 * n);
+    }
+}
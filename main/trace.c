@@ -0,0 +1,114 @@
+/*
+ * Klimper: ESP32 I²S Synthesizer Test
+ * © 2024 Dennis Schulmeister-Zimolong <dennis@wpvs.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ */
+
+#include "trace.h"
+
+#if CONFIG_TRACE_ENABLE
+#include <esp_log.h>                        // ESP_LOGx
+#include <esp_timer.h>                      // esp_timer_get_time()
+#include <stdio.h>                          // fwrite(), fflush(), flockfile()
+
+#if !CONFIG_FREERTOS_UNICORE
+#include <esp_ipc.h>                        // esp_ipc_call_blocking()
+#endif
+
+_Static_assert((CONFIG_TRACE_N_RECORDS & (CONFIG_TRACE_N_RECORDS - 1)) == 0, "CONFIG_TRACE_N_RECORDS must be a power of two");
+
+#define TRACE_VERSION (1)                   // Version of the binary frame format
+
+static const char* TAG = "trace";
+
+trace_ring_t  trace_rings[portNUM_PROCESSORS];
+volatile bool trace_running = false;
+
+/**
+ * Cycle counter and system time read on the same core at the same time. The cycle
+ * counters of the cores are not synchronized, so each core needs its own pair.
+ */
+typedef struct {
+    uint32_t cycles;                        // CPU cycle counter
+    int64_t  time_us;                       // System time
+} trace_sync_t;
+
+/**
+ * Start recording.
+ */
+void trace_init() {
+    ESP_LOGI(TAG, "Recording trace with %i records per core", CONFIG_TRACE_N_RECORDS);
+    trace_running = true;
+}
+
+/**
+ * Read the time stamps of the calling core.
+ */
+static void trace_sync(void* arg) {
+    trace_sync_t* sync = arg;
+    sync->cycles  = esp_cpu_get_cycle_count();
+    sync->time_us = esp_timer_get_time();
+}
+
+/**
+ * Write raw bytes to the serial console.
+ */
+static inline void trace_write(const void* data, size_t size) {
+    fwrite(data, 1, size, stdout);
+}
+
+/**
+ * Dump the ring buffers of all cores as one binary frame (all values little endian):
+ *
+ *   "KTRC\n", u8 version, u8 cores, u16 CPU MHz, u32 records per core
+ *   For each core: u32 next, u32 sync cycles, i64 sync time in µs, records
+ *   "KEND"
+ *
+ * The line feed in the magic allows the host to detect the CR/LF translation of the console.
+ * The console stays locked for the whole frame, so that log output of other tasks waits
+ * instead of ending up between the records.
+ */
+void trace_dump() {
+    trace_running = false;
+    flockfile(stdout);
+
+    uint8_t  version   = TRACE_VERSION;
+    uint8_t  n_cores   = portNUM_PROCESSORS;
+    uint16_t cpu_mhz   = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+    uint32_t n_records = CONFIG_TRACE_N_RECORDS;
+
+    fflush(stdout);
+    trace_write("KTRC\n", 5);
+    trace_write(&version,   sizeof(version));
+    trace_write(&n_cores,   sizeof(n_cores));
+    trace_write(&cpu_mhz,   sizeof(cpu_mhz));
+    trace_write(&n_records, sizeof(n_records));
+
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        trace_sync_t sync;
+
+#if !CONFIG_FREERTOS_UNICORE
+        if (core != esp_cpu_get_core_id()) esp_ipc_call_blocking(core, trace_sync, &sync);
+        else trace_sync(&sync);
+#else
+        trace_sync(&sync);
+#endif
+
+        trace_ring_t* ring = &trace_rings[core];
+        trace_write(&ring->next,    sizeof(ring->next));
+        trace_write(&sync.cycles,   sizeof(sync.cycles));
+        trace_write(&sync.time_us,  sizeof(sync.time_us));
+        trace_write(ring->records,  sizeof(ring->records));
+    }
+
+    trace_write("KEND", 4);
+    fflush(stdout);
+
+    funlockfile(stdout);
+    trace_running = true;
+}
+#endif
@@ -0,0 +1,98 @@
+/*
+ * Klimper: ESP32 I²S Synthesizer Test
+ * © 2024 Dennis Schulmeister-Zimolong <dennis@wpvs.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ */
+
+#pragma once
+
+#include <stdint.h>                         // uint16_t, uint32_t
+#include "sdkconfig.h"                      // CONFIG_TRACE_ENABLE
+
+#if CONFIG_TRACE_ENABLE
+#include <esp_cpu.h>                        // esp_cpu_get_cycle_count(), esp_cpu_get_core_id()
+#include <stdbool.h>                        // bool, true, false
+#include <freertos/FreeRTOS.h>              // portNUM_PROCESSORS
+#endif
+
+/**
+ * Traced events. The argument of each record depends on the event. `_BEGIN`/`_END`
+ * pairs become slices on the timeline, all other events instants.
+ */
+typedef enum {
+    TRACE_I2S_ISR = 1,                      // I²S DMA buffer sent (arg: dropped buffers so far)
+    TRACE_DSP_BEGIN,                        // DSP task woken up with a new buffer
+    TRACE_DSP_END,                          // DSP task finished the buffer
+    TRACE_SEQUENCER_BEGIN,                  // `sequencer_process()` started
+    TRACE_SEQUENCER_END,                    // `sequencer_process()` finished
+    TRACE_NOTE_ON,                          // Note on (arg: note)
+    TRACE_NOTE_OFF,                         // Note off (arg: note)
+    TRACE_VOICE_STEAL,                      // Sounding voice stolen for a new note (arg: voice)
+    TRACE_UI_EVENT,                         // Button or rotary encoder event handled by the UI task (arg: button)
+} trace_event_t;
+
+/**
+ * One binary trace record. The time stamp is the raw CPU cycle counter of the
+ * recording core, which is converted to system time only when the trace is dumped.
+ */
+typedef struct {
+    uint32_t cycles;                        // CPU cycle counter
+    uint16_t event;                         // Event (`trace_event_t`)
+    uint16_t arg;                           // Event argument
+} trace_record_t;
+
+#if CONFIG_TRACE_ENABLE
+/**
+ * Ring buffer of a single CPU core. Only ever written by its own core, but the writer
+ * may be interrupted by an ISR on the same core, which is why each record slot is
+ * reserved with an atomic increment instead of a lock.
+ */
+typedef struct {
+    uint32_t       next;                    // Number of records written so far (modulo 2^32)
+    trace_record_t records[CONFIG_TRACE_N_RECORDS];
+} trace_ring_t;
+
+extern trace_ring_t  trace_rings[portNUM_PROCESSORS];
+extern volatile bool trace_running;
+
+/**
+ * Record an event in the ring buffer of the calling core. This is inlined and only
+ * costs a cycle counter read, an atomic increment and one store of eight bytes, so
+ * it can be called from ISRs and the DSP task.
+ *
+ * @param event Event
+ * @param arg Event argument
+ */
+static inline void trace_record(trace_event_t event, uint16_t arg) {
+    if (!trace_running) return;
+
+    trace_ring_t* ring = &trace_rings[esp_cpu_get_core_id()];
+    uint32_t      i    = __atomic_fetch_add(&ring->next, 1, __ATOMIC_RELAXED) & (CONFIG_TRACE_N_RECORDS - 1);
+
+    ring->records[i] = (trace_record_t) {
+        .cycles = esp_cpu_get_cycle_count(),
+        .event  = (uint16_t) event,
+        .arg    = arg,
+    };
+}
+
+/**
+ * Start recording. Before, all trace calls return immediately.
+ */
+void trace_init();
+
+/**
+ * Write the last records of all cores to the serial console as one binary frame,
+ * see `tools/trace2perfetto.py` for the format and the conversion into a timeline.
+ * Recording is paused while the trace is dumped.
+ */
+void trace_dump();
+#else
+static inline void trace_record(trace_event_t event, uint16_t arg) {}
+static inline void trace_init() {}
+static inline void trace_dump() {}
+#endif
@@ -17,6 +17,12 @@
  */
 typedef void (*ui_callback_ptr)(void* arg);
 
+/**
+ * Custom callback function to fill a read-only information page with two lines of
+ * text. Each line has room for 16 characters plus the terminating null byte.
+ */
+typedef void (*ui_info_ptr)(char* line1, char* line2, void* arg);
+
 struct ui_command;
 
 /**
@@ -40,7 +46,11 @@ typedef struct {
  * rotary encoder after the command has been activated. The command name and the current
  * value will be shown on the LCD display. If `cb.value` is set that callback will be
  * executed after every value change caused by the UI (e.g. to recalculate envelope
- * factors etc.).
+ * factors etc.). If the value can also change outside the UI, `cb.sync` is called by
+ * the UI task to copy the new value into the parameter, before it is shown or changed.
+ *
+ * If `cb.info` is set, the command shows a read-only information page, which is
+ * periodically refreshed by calling the callback until the EXIT button is pressed.
  *
  * Commands can be nested to build a hierarchical menu structure. In this case the parent
  * command would typically not contain any callbacks or numeric value but just a list of
@@ -61,6 +71,8 @@ typedef struct ui_command {
     struct {                                // Callback functions (optional)
         ui_callback_ptr execute;            // Callback when the function is selected (optional)
         ui_callback_ptr value;              // Callback when the value has been changed (optional)
+        ui_callback_ptr sync;               // Callback to pick up outside changes of the value (optional)
+        ui_info_ptr     info;               // Callback to fill a read-only information page (optional)
         void* arg;                          // User argument for the callback functions
     } cb;
 
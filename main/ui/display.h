@@ -43,3 +43,11 @@ void ui_display_show_menu(ui_menu_t* menu, unsigned int selection);
  * @param value Current value
  */
 void ui_display_show_param(char* name, float value);
+
+/**
+ * Show two lines of arbitrary text, e.g. for a read-only information page.
+ *
+ * @param line1 First line
+ * @param line2 Second line
+ */
+void ui_display_show_text(char* line1, char* line2);
@@ -17,7 +17,7 @@
 
 #include <hd44780.h>                        // ESP-IDF-LIB: hd44780_xyz
 #include <stdio.h>                          // printf
-#include <string.h>                         // strncpy, strlen
+#include <string.h>                         // strncpy, strnlen, memcpy, memset
 #include <ctype.h>                          // toupper
 #include <stdbool.h>                        // bool, true, false
 
@@ -38,39 +38,61 @@ hd44780_t lcd = {
     },
 };
 
+#define LCD_LINES   (2)                     // Number of lines
+#define LCD_COLUMNS (16)                    // Characters per line
+
+// Shadow framebuffer: Characters currently on the display and those of the next redraw.
+// Only the cells that differ are sent to the display, as each bus transaction is slow.
+static char lcd_shown[LCD_LINES][LCD_COLUMNS];
+static char lcd_next[LCD_LINES][LCD_COLUMNS];
+
 /* Initialize display implementation.  */
 void ui_display_init() {
     hd44780_init(&lcd);
     hd44780_control(&lcd, true, false, false);
     hd44780_clear(&lcd);
+
+    memset(lcd_shown, ' ', sizeof(lcd_shown));
+    memset(lcd_next,  ' ', sizeof(lcd_next));
 }
 
-/* Output a line of text. */
+/* Draw a line of text centered into the next frame. */
 void print_line(int line, char* text) {
     if (line < 1) line = 1;
     else if (line > 2) line = 2;
     line--;
 
-    char buffer[17] = {};
-    strncpy(buffer, text, 16);
-    buffer[16] = '\0';
+    size_t length = strnlen(text, LCD_COLUMNS);
+    size_t p      = (LCD_COLUMNS - length) / 2;
 
-    int p = (16 - strlen(buffer)) / 2;
-    int col = 0;
+    memset(lcd_next[line], ' ', LCD_COLUMNS);
+    memcpy(lcd_next[line] + p, text, length);
+}
 
-    for (; col < p; col++) {
-        hd44780_gotoxy(&lcd, col, line);
-        hd44780_putc(&lcd, ' ');
-    }
+/*
+ * Send the changed cells of the next frame to the display. The display advances the
+ * cursor by itself after each character, so the cursor is only moved at the start of
+ * each run of changed cells.
+ */
+void print_flush() {
+    for (int line = 0; line < LCD_LINES; line++) {
+        int cursor = -1;
+
+        for (int col = 0; col < LCD_COLUMNS; col++) {
+            char c = lcd_next[line][col];
+            if (c == lcd_shown[line][col]) continue;
 
-    hd44780_gotoxy(&lcd, col + 1, line);
-    hd44780_puts(&lcd, text);
+            if (cursor != col) hd44780_gotoxy(&lcd, col, line);
+            hd44780_putc(&lcd, c);
+
+            lcd_shown[line][col] = c;
+            cursor = col + 1;
+        }
+    }
 }
 
 /* Show menu items */
 void ui_display_show_menu(ui_menu_t* menu, unsigned int selection) {
-    hd44780_clear(&lcd);
-
     char line1[32] = {};
     char line2[32] = {};
 
@@ -89,15 +111,22 @@ void ui_display_show_menu(ui_menu_t* menu, unsigned int selection) {
 
     print_line(1, line1);
     print_line(2, line2);
+    print_flush();
 }
 
 /* Show numeric parameter. */
 void ui_display_show_param(char* name, float value) {
-    hd44780_clear(&lcd);
-
     print_line(1, name);
 
     char buffer[32] = {};
     sprintf(buffer, "% f", value);
     print_line(2, buffer);
+    print_flush();
+}
+
+/* Show two lines of text. */
+void ui_display_show_text(char* line1, char* line2) {
+    print_line(1, line1);
+    print_line(2, line2);
+    print_flush();
 }
@@ -98,3 +98,10 @@ void ui_display_show_param(char* name, float value) {
     sprintf(buffer, "% f", value);
     print_line(2, buffer);
 }
+
+/* Show two lines of text. */
+void ui_display_show_text(char* line1, char* line2) {
+    print_frame();
+    print_line(1, line1);
+    print_line(2, line2);
+}
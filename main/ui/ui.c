@@ -19,27 +19,32 @@
 #include <esp_log.h>                        // ESP_LOGx
 #include <stdbool.h>                        // bool, true, false
 #include <string.h>                         // memcpy, memset
+#include "../trace.h"                       // trace_record()
 
 static const char* TAG = "UI";              // Logging tag
 
 static const TickType_t q_wait_delay   = 100 / portTICK_PERIOD_MS;      // Max. waiting time for the event queue
+static const int info_refresh_ms       = 500;                           // Refresh interval of the information pages
+static const int redraw_interval_ms    = 40;                            // Shortest time between two redraws (25 per second)
 static const int debounce_button_ms    = 300;                           // Artificial delay to debounce the buttons
 static const int debounce_rotary_ms    = 50;                            // Artificial delay to debounce the rotary encoder
-static volatile int64_t debounce_until = 0;                             // System time until when to ignore GPIO events
+
+static volatile int64_t debounce_until[GPIO_NUM_MAX] = {};              // System time until when to ignore each GPIO input
+static volatile int     renc_delta = 0;                                 // Rotary encoder steps not yet handled by the UI task
 
 typedef enum {
     UI_BUTTON_NONE = 0,                     // No button-press detected or button was already handled
     UI_BUTTON_ENTER,                        // ENTER button
     UI_BUTTON_EXIT,                         // EXIT button
     UI_BUTTON_HOME,                         // HOME button
-    UI_BUTTON_INCREASE,                     // Rotary encoder INCREASE
-    UI_BUTTON_DECREASE,                     // Rotary encoder DECREASE
+    UI_BUTTON_ROTATE,                       // Rotary encoder turned by `delta` steps
     UI_BUTTON_COMMAND,                      // One of the configured command buttons
 } ui_button_t;
 
 typedef struct {
     ui_button_t   btn;                      // Pressed button
     ui_command_t* cmd;                      // Command button: Which command
+    int           delta;                    // Rotary encoder: Steps since the last event (negative to decrease)
 } ui_button_event_t;
 
 // Utility functions
@@ -50,13 +55,16 @@ void              add_cmd_button_isr_handlers  (ui_menu_t* menu);
 void              cmd_button_isr_handler       (void *arg);
 void              menu_button_isr_handler      (void *arg);
 void              rotary_encoder_isr_handler   (void *arg);
-bool              debounce                     (int millis);
-ui_button_event_t get_button_event             ();
+bool              debounce                     (int io_pin, int millis);
+ui_button_event_t get_button_event             (TickType_t wait);
+TickType_t        redraw_wait                  (bool redraw, int64_t redraw_at);
+bool              sync_parameter               (ui_command_t* cmd);
 ui_button_event_t execute_command              (ui_command_t* cmd);
 
 // Screen logic
 ui_button_event_t screen_menu                  (ui_menu_t* menu);
 ui_button_event_t screen_parameter             (ui_command_t* cmd);
+ui_button_event_t screen_info                  (ui_command_t* cmd);
 void              ui_task                      (void* parameters);
 
 ui_config_t config = {};                    // UI configuration (global copy)
@@ -172,8 +180,9 @@ void add_cmd_button_isr_handlers(ui_menu_t* menu) {
  * Interrupt handler for the direct-access command buttons. Posts a button event to the UI task.
  */
 void cmd_button_isr_handler(void *arg) {
-    if (debounce(debounce_button_ms)) return;
-    ui_button_event_t event = {.btn = UI_BUTTON_COMMAND, .cmd = (ui_command_t*) arg};
+    ui_command_t* cmd = (ui_command_t*) arg;
+    if (debounce(cmd->button_io, debounce_button_ms)) return;
+    ui_button_event_t event = {.btn = UI_BUTTON_COMMAND, .cmd = cmd};
 
     BaseType_t higherPriorityTaskWoken = pdFALSE;
     xQueueSendFromISR(event_queue, &event, &higherPriorityTaskWoken);
@@ -184,8 +193,12 @@ void cmd_button_isr_handler(void *arg) {
  * Interrupt handler for the navigation buttons. Posts a button event to the UI task.
  */
 void menu_button_isr_handler(void *arg) {
-    if (debounce(debounce_button_ms)) return;
-    ui_button_event_t event = {.btn = (ui_button_t) arg};
+    ui_button_t btn    = (ui_button_t) arg;
+    int         io_pin = btn == UI_BUTTON_ENTER ? config.btn_enter_io :
+                         btn == UI_BUTTON_EXIT  ? config.btn_exit_io  : config.btn_home_io;
+
+    if (debounce(io_pin, debounce_button_ms)) return;
+    ui_button_event_t event = {.btn = btn};
 
     BaseType_t higherPriorityTaskWoken = pdFALSE;
     xQueueSendFromISR(event_queue, &event, &higherPriorityTaskWoken);
@@ -193,12 +206,16 @@ void menu_button_isr_handler(void *arg) {
 }
 
 /**
- * Interrupt handler for the rotary encoder. Posts a button event to the UI task.
+ * Interrupt handler for the rotary encoder. The steps are accumulated until the UI task
+ * fetches them, and only the first step after that posts an event, so that fast turning
+ * neither floods the queue nor causes a redraw per step.
  */
 void rotary_encoder_isr_handler(void *arg) {
-    if (debounce(debounce_rotary_ms)) return;
+    if (debounce(config.renc_clk_io, debounce_rotary_ms)) return;
     bool increase = gpio_get_level(config.renc_dir_io);
-    ui_button_event_t event = { .btn = increase ? UI_BUTTON_INCREASE : UI_BUTTON_DECREASE };
+
+    if (__atomic_fetch_add(&renc_delta, increase ? 1 : -1, __ATOMIC_RELAXED) != 0) return;
+    ui_button_event_t event = { .btn = UI_BUTTON_ROTATE };
 
     BaseType_t higherPriorityTaskWoken = pdFALSE;
     xQueueSendFromISR(event_queue, &event, &higherPriorityTaskWoken);
@@ -208,26 +225,60 @@ void rotary_encoder_isr_handler(void *arg) {
 /**
  * Utility function to debounce GPIO inputs. Returns `true` when we are still debouncing
  * and the current event must be ignored. Saves the time until when debounce occurs.
+ * Each input has its own debounce time, so that e.g. turning the rotary encoder doesn't
+ * swallow a button press.
  */
-bool debounce(int millis) {
+bool debounce(int io_pin, int millis) {
     int64_t time  = esp_timer_get_time();
-    int64_t until = debounce_until;
-    debounce_until = time + (millis * 1000);
+    int64_t until = debounce_until[io_pin];
+    debounce_until[io_pin] = time + (millis * 1000);
     return until > time;
 }
 
 /**
  * Get latest button event sent from the interrupt handlers. If no event is received
- * after `q_wait_delay` milliseconds a `UI_BUTTON_NONE` event is returned.
+ * after `wait` ticks a `UI_BUTTON_NONE` event is returned. For the rotary encoder all
+ * steps accumulated so far are returned at once.
  */
-ui_button_event_t get_button_event() {
+ui_button_event_t get_button_event(TickType_t wait) {
     ui_button_event_t event = {};
-    xQueueReceive(event_queue, &event, q_wait_delay);
+    xQueueReceive(event_queue, &event, wait);
 
-    if (event.btn) ESP_LOGI(TAG, "Button event: %i", event.btn);
+    if (event.btn == UI_BUTTON_ROTATE) {
+        event.delta = __atomic_exchange_n(&renc_delta, 0, __ATOMIC_RELAXED);
+        if (!event.delta) event.btn = UI_BUTTON_NONE;
+    }
+
+    if (event.btn) trace_record(TRACE_UI_EVENT, (uint16_t) event.btn);
+    if (event.btn) ESP_LOGD(TAG, "Button event: %i (%i)", event.btn, event.delta);
     return event;
 }
 
+/**
+ * Time to wait for the next button event on screens with rate-limited redraws: Only until
+ * the pending redraw is due, otherwise the usual time.
+ */
+TickType_t redraw_wait(bool redraw, int64_t redraw_at) {
+    if (!redraw) return q_wait_delay;
+
+    int64_t wait_us = redraw_at - esp_timer_get_time();
+    if (wait_us <= 0) return 0;
+
+    return (TickType_t) (wait_us / 1000 / portTICK_PERIOD_MS) + 1;
+}
+
+/**
+ * Pick up changes of a command's parameter made outside the UI, using its `cb.sync`
+ * callback. Returns `true` when the value has changed and must be redrawn.
+ */
+bool sync_parameter(ui_command_t* cmd) {
+    if (!cmd->cb.sync) return false;
+
+    float value = *cmd->param.value;
+    cmd->cb.sync(cmd->cb.arg);
+    return *cmd->param.value != value;
+}
+
 /**
  * Background task for the actual UI logic. Simply sits in a loop and calls the function
  * the runs the home screen. Also handles the global buttons that the home screen returns
@@ -251,6 +302,7 @@ ui_button_event_t execute_command(ui_command_t* cmd) {
     if (cmd->cb.execute) cmd->cb.execute(cmd->cb.arg);
 
     if (cmd->param.value)       return screen_parameter(cmd);
+    if (cmd->cb.info)           return screen_info(cmd);
     if (cmd->sub_menu.commands) return screen_menu(&cmd->sub_menu);
 
     ui_button_event_t dummy = {};
@@ -262,37 +314,36 @@ ui_button_event_t execute_command(ui_command_t* cmd) {
  */
 ui_button_event_t screen_menu(ui_menu_t* menu) {
     bool redraw = true;
+    int64_t redraw_at = 0;
     int selection = 0;
     ui_button_event_t event = {};
 
     while (true) {
-        if (redraw) {
-            if (selection < 0) selection = menu->n_commands - 1;
-            else if (selection > menu->n_commands - 1) selection = 0;
+        if (redraw && esp_timer_get_time() >= redraw_at) {
+            if (menu->n_commands > 0) {
+                selection %= menu->n_commands;
+                if (selection < 0) selection += menu->n_commands;
+            }
 
             ui_display_show_menu(menu, (unsigned int) selection);
-            redraw = false;
+            redraw    = false;
+            redraw_at = esp_timer_get_time() + redraw_interval_ms * 1000;
         }
 
-        if (!event.btn) event = get_button_event();
+        if (!event.btn) event = get_button_event(redraw_wait(redraw, redraw_at));
 
         switch (event.btn) {
-            case UI_BUTTON_INCREASE:
-                event.btn = UI_BUTTON_NONE;
-                selection++;
-                redraw = true;
-                break;
-
-            case UI_BUTTON_DECREASE:
+            case UI_BUTTON_ROTATE:
                 event.btn = UI_BUTTON_NONE;
-                selection--;
+                selection += event.delta;
                 redraw = true;
                 break;
 
             case UI_BUTTON_ENTER:
                 event.btn = UI_BUTTON_NONE;
                 event = execute_command(&menu->commands[selection]);
-                redraw = true;
+                redraw    = true;
+                redraw_at = 0;
                 break;
 
             case UI_BUTTON_EXIT:
@@ -312,41 +363,89 @@ ui_button_event_t screen_menu(ui_menu_t* menu) {
 }
 
 /**
- * Change parameter screen.
+ * Change parameter screen. The value callback runs at the redraw rate, a change still
+ * pending when the screen is left is sent before returning.
  */
 ui_button_event_t screen_parameter(ui_command_t* cmd) {
-    bool redraw = true;
+    bool redraw  = true;
+    bool changed = false;
+    int64_t redraw_at = 0;
     ui_button_event_t event = {};
 
     while (true) {
-        if (redraw) {
-            if (*cmd->param.value < cmd->param.min) *cmd->param.value = cmd->param.min;
-            else if (*cmd->param.value > cmd->param.max) *cmd->param.value = cmd->param.max;
+        if (sync_parameter(cmd)) redraw = true;
+
+        if (redraw && esp_timer_get_time() >= redraw_at) {
+            if (changed && cmd->cb.value) cmd->cb.value(cmd->cb.arg);
 
             ui_display_show_param(cmd->name, *cmd->param.value);
-            redraw = false;
+            redraw    = false;
+            changed   = false;
+            redraw_at = esp_timer_get_time() + redraw_interval_ms * 1000;
         }
 
-        if (!event.btn) event = get_button_event();
+        if (!event.btn) event = get_button_event(redraw_wait(redraw, redraw_at));
 
         switch (event.btn) {
-            case UI_BUTTON_INCREASE:
+            case UI_BUTTON_ROTATE:
                 event.btn = UI_BUTTON_NONE;
-                *cmd->param.value += cmd->param.step;
-                redraw = true;
+                sync_parameter(cmd);
+                *cmd->param.value += cmd->param.step * event.delta;
+
+                if (*cmd->param.value < cmd->param.min) *cmd->param.value = cmd->param.min;
+                else if (*cmd->param.value > cmd->param.max) *cmd->param.value = cmd->param.max;
+
+                redraw  = true;
+                changed = true;
                 break;
 
-            case UI_BUTTON_DECREASE:
+            case UI_BUTTON_EXIT:
+                if (changed && cmd->cb.value) cmd->cb.value(cmd->cb.arg);
+                event.btn = UI_BUTTON_NONE;
+                return event;
+
+            case UI_BUTTON_ENTER:
+            case UI_BUTTON_NONE:
+                // Ignored buttons
                 event.btn = UI_BUTTON_NONE;
-                *cmd->param.value -= cmd->param.step;
-                redraw = true;
                 break;
 
+            default:
+                // Buttons handled by one of the parents, send a change still waiting for the redraw
+                if (changed && cmd->cb.value) cmd->cb.value(cmd->cb.arg);
+                return event;
+        }
+    }
+}
+
+/**
+ * Read-only information page. Refreshed periodically, as the information usually
+ * changes all the time.
+ */
+ui_button_event_t screen_info(ui_command_t* cmd) {
+    int64_t redraw_at = 0;
+    ui_button_event_t event = {};
+
+    while (true) {
+        if (esp_timer_get_time() >= redraw_at) {
+            char line1[17] = {};
+            char line2[17] = {};
+
+            cmd->cb.info(line1, line2, cmd->cb.arg);
+            ui_display_show_text(line1, line2);
+
+            redraw_at = esp_timer_get_time() + info_refresh_ms * 1000;
+        }
+
+        if (!event.btn) event = get_button_event(q_wait_delay);
+
+        switch (event.btn) {
             case UI_BUTTON_EXIT:
                 event.btn = UI_BUTTON_NONE;
                 return event;
 
             case UI_BUTTON_ENTER:
+            case UI_BUTTON_ROTATE:
             case UI_BUTTON_NONE:
                 // Ignored buttons
                 event.btn = UI_BUTTON_NONE;
@@ -358,4 +457,3 @@ ui_button_event_t screen_parameter(ui_command_t* cmd) {
         }
     }
 }
-
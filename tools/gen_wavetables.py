@@ -0,0 +1,181 @@
+#!/usr/bin/env python3
+#
+# Generate the built-in wavetables of `dsp_wavetable_get()` and `dsp_wavetable_mipmap_get()`
+# as constant C arrays, so that they don't need to be computed into the heap at start-up.
+# Called by the build with the configured wavetable length. Usage:
+#
+#   gen_wavetables.py CONFIG_DSP_WAVETABLE_LENGTH wavetables.c
+#
+# The values are the same as the ones computed by `dsp_wavetable_new()`,
+# `dsp_wavetable_new_logsin()`, `dsp_wavetable_new_exp2()` and `dsp_wavetable_mipmap_new()`,
+# except that they are calculated with double precision. The placement in flash or DRAM
+# is decided by the C preprocessor with the CONFIG_DSP_WAVETABLE_xyz options.
+
+import cmath
+import math
+import struct
+import sys
+
+LOGSIN_LENGTH = 1024                        # DSP_WAVETABLE_LOGSIN_LENGTH
+EXP2_LENGTH   = 1024                        # DSP_WAVETABLE_EXP2_LENGTH
+LOG_OCTAVE    = 1024                        # DSP_LOG_OCTAVE
+Q15_ONE       = 32767                       # DSP_Q15_ONE
+OVERSAMPLING  = 4                           # DSP_WAVETABLE_MIPMAP_OVERSAMPLING
+
+# Naive waveforms of the mipmaps, in the order of `dsp_wavetable_mipmap_default_t`
+MIPMAPS = {
+    "saw":      lambda x: x / math.pi - 1.0,
+    "square":   lambda x: 1.0 if x < math.pi else -1.0,
+    "triangle": lambda x: x / (math.pi / 2) if x < math.pi / 2
+                     else 2.0 - x / (math.pi / 2) if x < 1.5 * math.pi
+                     else x / (math.pi / 2) - 4.0,
+}
+
+def f32(value):
+    return struct.unpack("f", struct.pack("f", value))[0]
+
+def q15(value):
+    # Same as dsp_q15_from_float()
+    value = f32(value)
+    if value >= 1.0:  return Q15_ONE
+    if value <= -1.0: return -Q15_ONE
+    return int(value * 32768.0)
+
+def fft(values):
+    # Iterative radix-2 FFT, the length must be a power of two
+    n      = len(values)
+    bits   = n.bit_length() - 1
+    result = [values[int(format(i, f"0{bits}b")[::-1], 2)] for i in range(n)]
+
+    size = 2
+    while size <= n:
+        step = cmath.exp(-2j * math.pi / size)
+        for start in range(0, n, size):
+            w = 1.0
+            for k in range(size // 2):
+                a = result[start + k]
+                b = result[start + k + size // 2] * w
+                result[start + k]             = a + b
+                result[start + k + size // 2] = a - b
+                w *= step
+        size *= 2
+
+    return result
+
+def mipmap_levels(func, length):
+    # Harmonic analysis of the oversampled naive waveform, like dsp_wavetable_mipmap_new()
+    n_samples    = length * OVERSAMPLING
+    max_harmonic = length // 2
+    n_levels     = (max_harmonic & -max_harmonic).bit_length()
+    spectrum     = fft([func(i * 2.0 * math.pi / n_samples) for i in range(n_samples)])
+
+    cos = [spectrum[k].real * (2.0 if k else 1.0) / n_samples for k in range(max_harmonic + 1)]
+    sin = [-spectrum[k].imag * 2.0 / n_samples for k in range(max_harmonic + 1)]
+
+    # Synthesis of each level up to its highest harmonic with an inverse FFT
+    levels = []
+    for level in range(n_levels):
+        bins = [0j] * length
+        for k in range((max_harmonic >> level) + 1):
+            bins[k] = complex(cos[k], sin[k])
+
+        values = [value.real for value in fft(bins)]
+        levels.append([f32(value) for value in values])
+
+    # Same scaling of all levels, so that the Gibbs overshoot doesn't clip
+    peak = max(abs(value) for values in levels for value in values)
+    if peak > 1.0:
+        levels = [[f32(value / peak) for value in values] for values in levels]
+
+    return max_harmonic, levels
+
+def literal(value):
+    # Shortest exact float literal, always with a decimal point or exponent
+    text = f"{value:.9g}"
+    return text + (".0f" if text.lstrip("-").isdigit() else "f")
+
+def array(type, name, values, attr):
+    if type == "float":
+        items = [literal(value) for value in values]
+    else:
+        items = [str(value) for value in values]
+
+    lines = [", ".join(items[i:i + 8]) for i in range(0, len(items), 8)]
+    body  = ",\n    ".join(lines)
+    return f"static const {type} {name}[{len(values)}] {attr} = {{\n    {body},\n}};\n\n"
+
+def table(name, length, samples, attr):
+    name = "table_" + name
+    # One guard point for the linear interpolation, like dsp_wavetable_new()
+    samples = samples + samples[:1]
+
+    code  = array("float", f"{name}_samples", samples, attr)
+    code += array("q15_t", f"{name}_samples_q15", [q15(value) for value in samples], attr)
+    code += f"static dsp_wavetable_t {name} = {{\n"
+    code += f"    .length      = {length},\n"
+    code += f"    .samples     = {name}_samples,\n"
+    code += f"    .samples_q15 = {name}_samples_q15,\n"
+    code += f"}};\n\n"
+    return code
+
+def table_u16(name, samples, attr):
+    name = "table_" + name
+    code  = array("uint16_t", f"{name}_samples_u16", samples, attr)
+    code += f"static dsp_wavetable_t {name} = {{\n"
+    code += f"    .length      = {len(samples)},\n"
+    code += f"    .samples_u16 = {name}_samples_u16,\n"
+    code += f"}};\n\n"
+    return code
+
+def main(length, output):
+    if length < 64 or length > 16384 or length & (length - 1):
+        sys.exit("The wavetable length must be a power of two from 64 to 16384")
+
+    code  = "/* Generated by gen_wavetables.py - do not edit */\n"
+    code += "#include <esp_attr.h>\n"
+    code += "#include \"dsp/wavetable.h\"\n\n"
+    code += f"_Static_assert(CONFIG_DSP_WAVETABLE_LENGTH == {length}, \"Generated wavetables are outdated\");\n\n"
+
+    for option, attr in (("DSP_WAVETABLE_DRAM", "DSP_WAVETABLE_ATTR"), ("DSP_WAVETABLE_MIPMAP_DRAM", "DSP_WAVETABLE_MIPMAP_ATTR")):
+        code += f"#if CONFIG_{option}\n#define {attr} DRAM_ATTR\n#else\n#define {attr}\n#endif\n\n"
+
+    code += table("sin", length, [f32(math.sin(i * 2.0 * math.pi / length)) for i in range(length)], "DSP_WAVETABLE_ATTR")
+    code += table("cos", length, [f32(math.cos(i * 2.0 * math.pi / length)) for i in range(length)], "DSP_WAVETABLE_ATTR")
+
+    logsin = [int(-math.log2(math.sin((i + 0.5) / LOGSIN_LENGTH * math.pi / 2)) * LOG_OCTAVE + 0.5) for i in range(LOGSIN_LENGTH)]
+    exp2   = [int(2.0 ** (-i / EXP2_LENGTH) * Q15_ONE + 0.5) for i in range(EXP2_LENGTH)]
+
+    code += table_u16("logsin", logsin, "DSP_WAVETABLE_ATTR")
+    code += table_u16("exp2",   exp2,   "DSP_WAVETABLE_ATTR")
+
+    code += "dsp_wavetable_t* const dsp_wavetable_generated[DSP_WAVETABLE_N] = {\n"
+    code += "    &table_sin, &table_cos, &table_logsin, &table_exp2,\n"
+    code += "};\n\n"
+
+    code += "#if CONFIG_DSP_WAVETABLE_MIPMAP_GENERATED\n"
+
+    for name, func in MIPMAPS.items():
+        max_harmonic, levels = mipmap_levels(func, length)
+
+        for level, samples in enumerate(levels):
+            code += table(f"{name}_{level}", length, samples, "DSP_WAVETABLE_MIPMAP_ATTR")
+
+        pointers = ", ".join(f"&table_{name}_{level}" for level in range(len(levels)))
+        code += f"static dsp_wavetable_t* mipmap_{name}_levels[{len(levels)}] = {{ {pointers} }};\n\n"
+        code += f"static dsp_wavetable_mipmap_t mipmap_{name} = {{\n"
+        code += f"    .n_levels     = {len(levels)},\n"
+        code += f"    .max_harmonic = {max_harmonic},\n"
+        code += f"    .levels       = mipmap_{name}_levels,\n"
+        code += f"}};\n\n"
+
+    code += "dsp_wavetable_mipmap_t* const dsp_wavetable_mipmap_generated[DSP_WAVETABLE_MIPMAP_N] = {\n"
+    code += "    " + ", ".join(f"&mipmap_{name}" for name in MIPMAPS) + ",\n"
+    code += "};\n"
+    code += "#endif\n"
+
+    with open(output, "w") as file:
+        file.write(code)
+
+if __name__ == "__main__":
+    if len(sys.argv) != 3: sys.exit("Usage: gen_wavetables.py length wavetables.c")
+    main(int(sys.argv[1]), sys.argv[2])
@@ -0,0 +1,128 @@
+#!/usr/bin/env python3
+#
+# Convert a trace dumped with the "Dump Trace" command (CONFIG_TRACE_ENABLE) into a
+# Chrome/Perfetto JSON trace, that can be opened in https://ui.perfetto.dev or
+# chrome://tracing. Usage: trace2perfetto.py capture.bin trace.json
+#
+# The capture is the raw output of the serial console, e.g. recorded with
+# `cat /dev/ttyUSB0 > capture.bin` while the dump is triggered. Log output before and
+# after the frame is skipped. `idf.py monitor` is not suitable, since it decodes the
+# output as text. If the console translates LF to CR/LF, this is detected from the
+# magic and undone. The frame length follows from its header, a frame that doesn't end
+# with the trailer exactly there is rejected.
+#
+# Only the last 2^32 CPU cycles before the dump (about 17 s at 240 MHz) can be placed
+# on the timeline, older records are dropped.
+
+import json
+import struct
+import sys
+
+MAGIC   = b"KTRC\n"
+TRAILER = b"KEND"
+VERSION = 1
+
+# Must match `trace_event_t` in main/trace.h: name and phase (B = begin, E = end, i = instant)
+EVENTS = {
+    1: ("I2S ISR",          "i"),
+    2: ("dsp_task",         "B"),
+    3: ("dsp_task",         "E"),
+    4: ("sequencer",        "B"),
+    5: ("sequencer",        "E"),
+    6: ("Note on",          "i"),
+    7: ("Note off",         "i"),
+    8: ("Voice steal",      "i"),
+    9: ("UI event",         "i"),
+}
+
+ARGS = {1: "dropped", 6: "note", 7: "note", 8: "voice", 9: "button"}
+
+def find_frame(data):
+    start = data.find(MAGIC)
+    crlf  = False
+
+    if start < 0:
+        start = data.find(MAGIC.replace(b"\n", b"\r\n"))
+        crlf  = True
+
+    if start < 0:
+        sys.exit("No trace frame found")
+
+    # The CR/LF translation makes the raw length unpredictable, so undo it for the whole
+    # rest of the capture first. The frame is then cut at the length given by its header.
+    frame = data[start:]
+    if crlf: frame = frame.replace(b"\r\n", b"\n")
+    frame = frame[len(MAGIC):]
+
+    if len(frame) < 8:
+        sys.exit("Trace frame is incomplete")
+
+    _, n_cores, _, n_records = struct.unpack_from("<BBHI", frame, 0)
+    length = 8 + n_cores * (16 + n_records * 8)
+
+    if len(frame) < length + len(TRAILER):
+        sys.exit("Trace frame is incomplete")
+
+    if frame[length:length + len(TRAILER)] != TRAILER:
+        sys.exit("Trace frame is corrupted (trailer not found at the end of the frame)")
+
+    return frame[:length]
+
+def parse(frame):
+    version, n_cores, cpu_mhz, n_records = struct.unpack_from("<BBHI", frame, 0)
+    if version != VERSION:
+        sys.exit(f"Unsupported trace version {version}")
+
+    offset = 8
+    cores  = []
+
+    for core in range(n_cores):
+        next, sync_cycles, sync_us = struct.unpack_from("<IIq", frame, offset)
+        offset += 16
+
+        records = list(struct.iter_unpack("<IHH", frame[offset:offset + n_records * 8]))
+        offset += n_records * 8
+
+        # Oldest record first
+        count   = min(next, n_records)
+        first   = (next - count) % n_records
+        ordered = [records[(first + i) % n_records] for i in range(count)]
+
+        cores.append((sync_cycles, sync_us, ordered))
+
+    return cpu_mhz, cores
+
+def convert(cpu_mhz, cores):
+    events = []
+
+    for core, (sync_cycles, sync_us, records) in enumerate(cores):
+        events.append({"name": "thread_name", "ph": "M", "pid": 0, "tid": core, "args": {"name": f"Core {core}"}})
+
+        for cycles, event, arg in records:
+            if event not in EVENTS: continue
+
+            name, phase = EVENTS[event]
+            age = (sync_cycles - cycles) & 0xffffffff
+            ts  = sync_us - age / cpu_mhz
+
+            entry = {"name": name, "ph": phase, "ts": ts, "pid": 0, "tid": core}
+            if phase == "i": entry["s"] = "t"
+            if event in ARGS: entry["args"] = {ARGS[event]: arg}
+
+            events.append(entry)
+
+    return {"traceEvents": events, "displayTimeUnit": "ms"}
+
+def main(capture, output):
+    with open(capture, "rb") as file:
+        cpu_mhz, cores = parse(find_frame(file.read()))
+
+    with open(output, "w") as file:
+        json.dump(convert(cpu_mhz, cores), file)
+
+    n_records = sum(len(records) for _, _, records in cores)
+    print(f"{n_records} records of {len(cores)} cores written to {output}")
+
+if __name__ == "__main__":
+    if len(sys.argv) != 3: sys.exit("Usage: trace2perfetto.py capture.bin trace.json")
+    main(sys.argv[1], sys.argv[2])